@@ -5,11 +5,14 @@
 
 #include <algorithm>
 #include <execution> // Execution policies
+#include <forward_list>
 #include <functional>
+#include <limits>
 #include <type_traits>
 #include <list>
 #include <memory>
 #include <utility>
+#include <vector>
 //#include <concepts>
 //#include <variant>	// for CommandListVariant
 
@@ -458,6 +461,255 @@ namespace pattern {
 
 			}; // !class MacroCommand
 
+
+//===============================Undo History=======================================
+
+			/**
+			 * Abstract. Command, that can revert results of its own execution.
+			 * Inverse state, needed for Undo, is stored inside of command object.
+			 */
+			class IUndoableCommand : public ICommand {
+			protected:
+				IUndoableCommand() = default;
+				IUndoableCommand(const IUndoableCommand&) = delete; // C.67	C.21
+				IUndoableCommand& operator=(const IUndoableCommand&) = delete;
+				IUndoableCommand(IUndoableCommand&&) noexcept = delete;
+				IUndoableCommand& operator=(IUndoableCommand&&) noexcept = delete;
+			public:
+				~IUndoableCommand() override = default;
+
+				/** Reverts the results of last Execute. Execute after Undo is Redo. */
+				virtual void Undo() = 0;
+
+				/** Memory, that is hold by command with its inverse state. Is used for budget of UndoHistory. */
+				virtual size_t SizeInBytes() const noexcept = 0;
+
+				/**
+				 * Absorbs next executed command, f.e. repeated edits of one value.
+				 * After merge Undo of this command must revert results of both commands.
+				 *
+				 * @param next_command	command, executed right after this one
+				 * @return				true, if next_command was merged and may be destroyed
+				 */
+				virtual bool MergeWith(const IUndoableCommand& /*next_command*/) { return false; };
+			};
+
+
+			/**
+			 * Undoable command, that assigns new value to target object.
+			 * Consecutive commands with the same target are merged in one history step.
+			 *
+			 * Invariant: target object must outlive command.
+			 */
+			template<typename ValueT>
+			requires std::is_copy_assignable_v<ValueT>
+			class CommandSetValue : public IUndoableCommand {
+			public:
+				CommandSetValue(ValueT& target_p, ValueT new_value_p)
+					: target_{ &target_p }, new_value_{ std::move(new_value_p) } {
+				};
+
+			protected:
+				CommandSetValue(const CommandSetValue&) = delete;	// polymorph suppress copy & move
+				CommandSetValue& operator=(const CommandSetValue&) = delete;
+				CommandSetValue(CommandSetValue&&) noexcept = delete;
+				CommandSetValue& operator=(CommandSetValue&&) noexcept = delete;
+
+			public:
+				~CommandSetValue() override = default;
+
+				inline void Execute() override {
+					old_value_ = std::exchange(*target_, new_value_);
+				};
+
+				inline void Undo() override {
+					*target_ = old_value_;
+				};
+
+				inline size_t SizeInBytes() const noexcept override { return sizeof(CommandSetValue); };
+
+				/** Merge only edits of the same target. Old value of first edit is kept. */
+				bool MergeWith(const IUndoableCommand& next_command) override {
+					const auto* next_set_value{ dynamic_cast<const CommandSetValue*>(&next_command) };
+					if (next_set_value && next_set_value->target_ == target_) {
+						new_value_ = next_set_value->new_value_;
+						return true;
+					}
+					return false;
+				};
+
+			private:
+				ValueT* target_;
+				ValueT new_value_;
+				/** Inverse state. Value of target before Execute. */
+				ValueT old_value_{};
+			}; // !class CommandSetValue
+
+
+			/**
+			 * Undo Manager. Bounded ring of executed commands, that hold their inverse state.
+			 * Undo and Redo are O(1) per step.
+			 * History never grows over capacity and byte budget: the oldest commands are evicted first.
+			 * The newest command is never evicted by byte budget.
+			 *
+			 * History: [oldest ... cursor_ ... size_). Commands before cursor_ can be undone, after - redone.
+			 */
+			class UndoHistory final {
+			public:
+				using CommandPtrT = std::unique_ptr<IUndoableCommand>;
+
+				/**
+				 * @param capacity_p		max count of commands in history. Minimum is 1.
+				 * @param bytes_budget_p	max sum of SizeInBytes() of commands in history.
+				 */
+				explicit UndoHistory(const size_t capacity_p,
+									 const size_t bytes_budget_p = std::numeric_limits<size_t>::max())
+					: ring_(std::max<size_t>(capacity_p, 1)), bytes_budget_{ bytes_budget_p } {
+				};
+
+				UndoHistory(const UndoHistory&) = delete;
+				UndoHistory& operator=(const UndoHistory&) = delete;
+				/** Moved-from history is empty with capacity 0. Execute restores capacity 1. */
+				UndoHistory(UndoHistory&& other) noexcept
+					: ring_{ std::move(other.ring_) }, head_{ std::exchange(other.head_, 0) }, size_{ std::exchange(other.size_, 0) },
+					  cursor_{ std::exchange(other.cursor_, 0) }, bytes_{ std::exchange(other.bytes_, 0) },
+					  bytes_budget_{ other.bytes_budget_ }, merge_allowed_{ std::exchange(other.merge_allowed_, false) } {
+					other.ring_.clear();
+				};
+				UndoHistory& operator=(UndoHistory&& other) noexcept {
+					if (this == &other) { return *this; }
+					ring_ = std::move(other.ring_);
+					other.ring_.clear();
+					head_ = std::exchange(other.head_, 0);
+					size_ = std::exchange(other.size_, 0);
+					cursor_ = std::exchange(other.cursor_, 0);
+					bytes_ = std::exchange(other.bytes_, 0);
+					bytes_budget_ = other.bytes_budget_;
+					merge_allowed_ = std::exchange(other.merge_allowed_, false);
+					return *this;
+				};
+				~UndoHistory() = default;
+
+				/**
+				 * Execute command and put it on top of history. Redo part of history is discarded.
+				 * Command is merged with the previous one, if it is possible.
+				 * If Execute throws, command is not recorded.
+				 */
+				void Execute(CommandPtrT&& command_p) {
+					if (!command_p) { return; }
+					if (ring_.empty()) { ring_.resize(1); }	// moved-from history
+					command_p->Execute();
+					DiscardRedo();
+
+					if (merge_allowed_ && size_ > 0) {
+						Entry& top{ ring_[Index(size_ - 1)] };
+						if (top.command->MergeWith(*command_p)) {
+							bytes_ -= top.size_in_bytes;
+							top.size_in_bytes = top.command->SizeInBytes();
+							bytes_ += top.size_in_bytes;
+							EnforceBudget();
+							return;
+						}
+					}
+
+					if (size_ == ring_.size()) { EvictOldest(); }
+					Entry& new_entry{ ring_[Index(size_)] };
+					new_entry.size_in_bytes = command_p->SizeInBytes();
+					new_entry.command = std::move(command_p);
+					bytes_ += new_entry.size_in_bytes;
+					cursor_ = ++size_;
+					merge_allowed_ = true;
+					EnforceBudget();
+				};
+
+				/** Revert the last executed command. @return false, if there is nothing to undo */
+				bool Undo() {
+					if (!CanUndo()) { return false; }
+					ring_[Index(cursor_ - 1)].command->Undo();
+					--cursor_;
+					merge_allowed_ = false;
+					return true;
+				};
+
+				/** Execute again the last undone command. @return false, if there is nothing to redo */
+				bool Redo() {
+					if (!CanRedo()) { return false; }
+					ring_[Index(cursor_)].command->Execute();
+					++cursor_;
+					merge_allowed_ = false;
+					return true;
+				};
+
+				/** Next command won't be merged with the top of history. F.e. on focus change in editor. */
+				inline void BreakMerge() noexcept { merge_allowed_ = false; };
+
+				/** Delete all commands from history. */
+				void Clear() noexcept {
+					for (size_t i{}; i < size_; ++i) { ring_[Index(i)] = Entry{}; }
+					head_ = size_ = cursor_ = bytes_ = 0;
+					merge_allowed_ = false;
+				};
+
+				inline bool CanUndo() const noexcept { return cursor_ > 0; };
+				inline bool CanRedo() const noexcept { return cursor_ < size_; };
+
+				inline size_t size() const noexcept { return size_; };
+				inline size_t capacity() const noexcept { return ring_.size(); };
+				inline size_t undo_count() const noexcept { return cursor_; };
+				inline size_t redo_count() const noexcept { return size_ - cursor_; };
+				inline size_t size_in_bytes() const noexcept { return bytes_; };
+				inline size_t bytes_budget() const noexcept { return bytes_budget_; };
+
+			private:
+				struct Entry {
+					CommandPtrT command{};
+					/** Size, accounted in bytes_. Command size may change after merge. */
+					size_t size_in_bytes{};
+				};
+
+				/** Ring position of n-th command from the oldest */
+				inline size_t Index(const size_t n) const noexcept { return (head_ + n) % ring_.size(); };
+
+				/** Delete undone commands after cursor_. */
+				void DiscardRedo() noexcept {
+					while (size_ > cursor_) {
+						Entry& entry{ ring_[Index(--size_)] };
+						bytes_ -= entry.size_in_bytes;
+						entry = Entry{};
+					}
+				};
+
+				/** Delete the oldest command. Oldest command is always in undo part of history. */
+				void EvictOldest() noexcept {
+					Entry& entry{ ring_[head_] };
+					bytes_ -= entry.size_in_bytes;
+					entry = Entry{};
+					head_ = Index(1);
+					--size_;
+					if (cursor_ > 0) { --cursor_; }
+				};
+
+				void EnforceBudget() noexcept {
+					while (bytes_ > bytes_budget_ && size_ > 1) { EvictOldest(); }
+				};
+
+// Data
+				std::vector<Entry> ring_;
+				size_t head_{};
+				size_t size_{};
+				size_t cursor_{};
+				size_t bytes_{};
+				size_t bytes_budget_;
+				bool merge_allowed_{ true };
+
+				/*
+				* Class Design:
+				* Ring is preallocated in constructor, so Execute does no allocations except command itself.
+				* Merge is disabled after Undo and Redo, so redone step stays separate step in history.
+				*/
+
+			}; // !class UndoHistory
+
 		} // !namespace command
 
 	} // !namespace behavioral
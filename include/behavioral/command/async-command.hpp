@@ -0,0 +1,385 @@
+﻿#ifndef ASYNC_COMMAND_HPP
+#define ASYNC_COMMAND_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace command_async {
+			// Command, which Execute is C++20 coroutine.
+			// Command, that waits for I/O, suspends and releases executor thread instead of blocking it.
+			// Executor thread can run other commands, while first one waits.
+			//
+			// Task<T>			- lazy awaitable coroutine result.
+			// ThreadPool		- executor of coroutines.
+			// IAsyncCommand	- interface of asynchronous commands.
+			// AsyncInvoker		- schedules commands on ThreadPool.
+			// AsyncMacroCommand - co_awaits sub-commands one by one.
+
+
+			template<typename T>
+			class Task;
+
+			/** Part of promise, that is common for Task<T> and Task<void> */
+			class TaskPromiseBase {
+			public:
+				/** Resumes coroutine, that awaits the task. Symmetric transfer: no stack growth in chains. */
+				struct FinalAwaiter {
+					inline bool await_ready() const noexcept { return false; };
+
+					template<typename PromiseT>
+					inline std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> handle_p) noexcept {
+						const std::coroutine_handle<> continuation{ handle_p.promise().continuation_ };
+						return continuation ? continuation : std::noop_coroutine();
+					};
+
+					inline void await_resume() const noexcept {};
+				};
+
+				/** Task is lazy. It is started, when it is awaited. */
+				inline std::suspend_always initial_suspend() const noexcept { return {}; };
+				inline FinalAwaiter final_suspend() const noexcept { return {}; };
+				inline void unhandled_exception() noexcept { exception_ = std::current_exception(); };
+
+				inline void set_continuation(const std::coroutine_handle<> continuation_p) noexcept {
+					continuation_ = continuation_p;
+				};
+
+			protected:
+				inline void RethrowIfFailed() const {
+					if (exception_) { std::rethrow_exception(exception_); }
+				};
+
+			private:
+				std::coroutine_handle<> continuation_{};
+				std::exception_ptr exception_{};
+			};
+
+			template<typename T>
+			class TaskPromise final : public TaskPromiseBase {
+			public:
+				inline Task<T> get_return_object() noexcept;
+
+				template<typename ValueT>
+				requires std::is_convertible_v<ValueT&&, T>
+				inline void return_value(ValueT&& value_p) { value_.emplace(std::forward<ValueT>(value_p)); };
+
+				inline T Result() {
+					RethrowIfFailed();
+					return std::move(*value_);
+				};
+
+			private:
+				std::optional<T> value_{};
+			};
+
+			template<>
+			class TaskPromise<void> final : public TaskPromiseBase {
+			public:
+				inline Task<void> get_return_object() noexcept;
+
+				inline void return_void() const noexcept {};
+
+				inline void Result() const { RethrowIfFailed(); };
+			};
+
+
+			/**
+			 * Result of coroutine. Lazy: coroutine body starts only, when Task is co_awaited.
+			 * Owns coroutine frame. Move only.
+			 */
+			template<typename T = void>
+			class [[nodiscard]] Task final {
+			public:
+				using promise_type = TaskPromise<T>;
+				using HandleT = std::coroutine_handle<promise_type>;
+
+				Task() = default;
+				explicit Task(const HandleT handle_p) noexcept : handle_{ handle_p } {};
+
+				Task(const Task&) = delete;
+				Task& operator=(const Task&) = delete;
+				Task(Task&& other) noexcept : handle_{ std::exchange(other.handle_, {}) } {};
+				Task& operator=(Task&& other) noexcept {
+					if (this != &other) {
+						if (handle_) { handle_.destroy(); }
+						handle_ = std::exchange(other.handle_, {});
+					}
+					return *this;
+				};
+				~Task() {
+					if (handle_) { handle_.destroy(); }
+				};
+
+				/** Start task and suspend awaiting coroutine until task is done. */
+				inline bool await_ready() const noexcept { return !handle_ || handle_.done(); };
+
+				inline std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiting_p) noexcept {
+					handle_.promise().set_continuation(awaiting_p);
+					return handle_;
+				};
+
+				inline T await_resume() { return handle_.promise().Result(); };
+
+				inline bool is_done() const noexcept { return !handle_ || handle_.done(); };
+
+			private:
+				HandleT handle_{};
+			}; // !class Task
+
+			template<typename T>
+			inline Task<T> TaskPromise<T>::get_return_object() noexcept {
+				return Task<T>{ std::coroutine_handle<TaskPromise<T>>::from_promise(*this) };
+			};
+
+			inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+				return Task<void>{ std::coroutine_handle<TaskPromise<void>>::from_promise(*this) };
+			};
+
+
+			/**
+			 * Small pool of worker threads, that resume coroutines.
+			 * Pending coroutines are resumed before destruction of pool.
+			 */
+			class ThreadPool final {
+			public:
+				explicit ThreadPool(const size_t threads_count_p = std::max(1u, std::thread::hardware_concurrency())) {
+					workers_.reserve(threads_count_p);
+					for (size_t i{}; i < std::max<size_t>(threads_count_p, 1); ++i) {
+						workers_.emplace_back([this]() { WorkerLoop(); });
+					}
+				};
+
+				ThreadPool(const ThreadPool&) = delete;
+				ThreadPool& operator=(const ThreadPool&) = delete;
+				ThreadPool(ThreadPool&&) noexcept = delete;
+				ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+				~ThreadPool() {
+					{
+						std::lock_guard lock{ mutex_ };
+						is_stopped_ = true;
+					}
+					condition_.notify_all();
+					for (std::thread& worker : workers_) { worker.join(); }
+				};
+
+				/** Awaiter, that continues coroutine on the thread of pool: co_await pool.Schedule(); */
+				struct ScheduleAwaiter {
+					ThreadPool& pool;
+
+					inline bool await_ready() const noexcept { return false; };
+					inline void await_suspend(const std::coroutine_handle<> handle_p) { pool.Post(handle_p); };
+					inline void await_resume() const noexcept {};
+				};
+
+				inline ScheduleAwaiter Schedule() noexcept { return ScheduleAwaiter{ *this }; };
+
+				/** Resume coroutine on one of workers. */
+				void Post(const std::coroutine_handle<> handle_p) {
+					{
+						std::lock_guard lock{ mutex_ };
+						queue_.push_back(handle_p);
+					}
+					condition_.notify_one();
+				};
+
+				inline size_t threads_count() const noexcept { return workers_.size(); };
+
+			private:
+				void WorkerLoop() {
+					while (true) {
+						std::coroutine_handle<> handle{};
+						{
+							std::unique_lock lock{ mutex_ };
+							condition_.wait(lock, [this]() { return is_stopped_ || !queue_.empty(); });
+							if (queue_.empty()) { return; } // stopped and drained
+							handle = queue_.front();
+							queue_.pop_front();
+						}
+						handle.resume();
+					}
+				};
+
+// Data
+				std::mutex mutex_{};
+				std::condition_variable condition_{};
+				std::deque<std::coroutine_handle<>> queue_{};
+				bool is_stopped_{};
+				std::vector<std::thread> workers_{};	// the last, threads use other data members
+			}; // !class ThreadPool
+
+
+			/**
+			 * Single shot event for coroutines. Waiters are suspended until Set().
+			 * Waiters are resumed on the thread, that calls Set(). Models completion of I/O.
+			 */
+			class AsyncEvent final {
+			public:
+				AsyncEvent() = default;
+				AsyncEvent(const AsyncEvent&) = delete;
+				AsyncEvent& operator=(const AsyncEvent&) = delete;
+				AsyncEvent(AsyncEvent&&) noexcept = delete;
+				AsyncEvent& operator=(AsyncEvent&&) noexcept = delete;
+				~AsyncEvent() = default;
+
+				struct Awaiter {
+					AsyncEvent& event;
+
+					inline bool await_ready() const noexcept { return event.is_set(); };
+
+					/** @return false, if event was set, while coroutine was suspending */
+					inline bool await_suspend(const std::coroutine_handle<> handle_p) {
+						std::lock_guard lock{ event.mutex_ };
+						if (event.is_set_) { return false; }
+						event.waiters_.push_back(handle_p);
+						return true;
+					};
+
+					inline void await_resume() const noexcept {};
+				};
+
+				inline Awaiter operator co_await() noexcept { return Awaiter{ *this }; };
+
+				void Set() {
+					std::vector<std::coroutine_handle<>> waiters{};
+					{
+						std::lock_guard lock{ mutex_ };
+						is_set_ = true;
+						waiters.swap(waiters_);
+					}
+					for (const std::coroutine_handle<> waiter : waiters) { waiter.resume(); }
+				};
+
+				inline bool is_set() const {
+					std::lock_guard lock{ mutex_ };
+					return is_set_;
+				};
+
+			private:
+				mutable std::mutex mutex_{};
+				bool is_set_{};
+				std::vector<std::coroutine_handle<>> waiters_{};
+			}; // !class AsyncEvent
+
+
+			/** Abstract. Interface of asynchronous commands. */
+			class IAsyncCommand {
+			protected:
+				IAsyncCommand() = default;
+				IAsyncCommand(const IAsyncCommand&) = delete; // C.67	C.21
+				IAsyncCommand& operator=(const IAsyncCommand&) = delete;
+				IAsyncCommand(IAsyncCommand&&) noexcept = delete;
+				IAsyncCommand& operator=(IAsyncCommand&&) noexcept = delete;
+			public:
+				virtual ~IAsyncCommand() = default;
+
+				/** Coroutine. Command object must be alive, until returned task is done. */
+				virtual Task<> Execute() = 0;
+			};
+
+
+			/**
+			 * Execute sequence of asynchronous commands one by one.
+			 * Next command starts, when previous is done. Composite pattern.
+			 */
+			class AsyncMacroCommand : public IAsyncCommand {
+			public:
+				using CommandPtrT = std::shared_ptr<IAsyncCommand>;
+
+				AsyncMacroCommand() = default;
+				explicit AsyncMacroCommand(std::vector<CommandPtrT> commands_p) noexcept
+					: commands_{ std::move(commands_p) } {
+				};
+
+			protected:
+				AsyncMacroCommand(const AsyncMacroCommand&) = delete;	// polymorph suppress copy & move
+				AsyncMacroCommand& operator=(const AsyncMacroCommand&) = delete;
+				AsyncMacroCommand(AsyncMacroCommand&&) noexcept = delete;
+				AsyncMacroCommand& operator=(AsyncMacroCommand&&) noexcept = delete;
+
+			public:
+				~AsyncMacroCommand() override = default;
+
+				Task<> Execute() override {
+					for (const CommandPtrT& command : commands_) {
+						if (command) { co_await command->Execute(); }
+					}
+				};
+
+				/** Container with commands */
+				std::vector<CommandPtrT> commands_{};
+			}; // !class AsyncMacroCommand
+
+
+			/**
+			 * Invoker, that runs asynchronous commands on ThreadPool.
+			 * Worker thread is released, while command is suspended.
+			 */
+			class AsyncInvoker final {
+			public:
+				using CommandPtrT = std::shared_ptr<IAsyncCommand>;
+
+				explicit AsyncInvoker(const size_t threads_count_p = 2) : pool_{ threads_count_p } {};
+
+				/**
+				 * Start command on pool. Invoker holds command, until it is done.
+				 *
+				 * @return future, that is ready, when command is done. Holds exception of command.
+				 */
+				std::future<void> InvokeCommand(CommandPtrT command_p) {
+					std::promise<void> done{};
+					std::future<void> done_future{ done.get_future() };
+					Run(pool_, std::move(command_p), std::move(done));
+					return done_future;
+				};
+
+				inline ThreadPool& pool() noexcept { return pool_; };
+
+			private:
+				/** Coroutine, that is started immediately and destroys itself on completion. */
+				struct DetachedTask {
+					struct promise_type {
+						inline DetachedTask get_return_object() const noexcept { return {}; };
+						inline std::suspend_never initial_suspend() const noexcept { return {}; };
+						inline std::suspend_never final_suspend() const noexcept { return {}; };
+						inline void return_void() const noexcept {};
+						inline void unhandled_exception() const noexcept { std::terminate(); };
+					};
+				};
+
+				static DetachedTask Run(ThreadPool& pool_p, CommandPtrT command_p, std::promise<void> done_p) {
+					co_await pool_p.Schedule();
+					std::exception_ptr exception{};
+					try {
+						if (command_p) { co_await command_p->Execute(); }
+					} catch (...) {
+						exception = std::current_exception();
+					}
+					exception ? done_p.set_exception(exception) : done_p.set_value();
+				};
+
+				ThreadPool pool_;
+			}; // !class AsyncInvoker
+
+		} // !namespace command_async
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !ASYNC_COMMAND_HPP
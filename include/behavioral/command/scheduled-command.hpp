@@ -0,0 +1,366 @@
+﻿#ifndef SCHEDULED_COMMAND_HPP
+#define SCHEDULED_COMMAND_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "behavioral/command.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace command_scheduler {
+			// Delayed and periodic execution of commands: retries, timeouts, heartbeats.
+			// http://www.cs.columbia.edu/~nahum/w6998/papers/sosp87-timing-wheels.pdf	Hashed and Hierarchical Timing Wheels
+			//
+			// Hierarchical timing wheel: 4 levels of 256 slots. Level 0 slot is one tick.
+			// Slot of level N holds timers, that expire in 256^N ticks. When lower level makes full turn,
+			// slot of upper level is cascaded to lower levels.
+			// Insert and Cancel are O(1). All commands, that expire in one tick, are executed in one batch.
+
+
+			/** Handle of scheduled command. Is used for cancellation. */
+			struct TimerHandle {
+				std::uint32_t index{ std::numeric_limits<std::uint32_t>::max() };
+				std::uint32_t generation{};
+			};
+
+
+			/**
+			 * Invoker, that executes commands after delay or periodically.
+			 * One driver thread advances hierarchical timing wheel and executes expired commands.
+			 * Commands are executed outside of lock, so command may Schedule or Cancel other commands.
+			 * Command never executes earlier, than its delay. Precision is one tick.
+			 *
+			 * Thread safe.
+			 */
+			class SchedulingInvoker final {
+			public:
+				using CommandPtrT = std::shared_ptr<command::ICommand>;
+				using ClockT = std::chrono::steady_clock;
+				using ErrorHandlerT = std::function<void(std::exception_ptr)>;
+
+				explicit SchedulingInvoker(const ClockT::duration tick_p = std::chrono::milliseconds(1))
+					: tick_{ tick_p > ClockT::duration::zero() ? tick_p : ClockT::duration(1) },
+					  start_time_{ ClockT::now() } {
+					buckets_.fill(kNull);
+					driver_ = std::thread([this]() { DriverLoop(); });
+				};
+
+				SchedulingInvoker(const SchedulingInvoker&) = delete;
+				SchedulingInvoker& operator=(const SchedulingInvoker&) = delete;
+				SchedulingInvoker(SchedulingInvoker&&) noexcept = delete;
+				SchedulingInvoker& operator=(SchedulingInvoker&&) noexcept = delete;
+
+				/** Not executed commands are discarded. */
+				~SchedulingInvoker() {
+					{
+						std::lock_guard lock{ mutex_ };
+						is_stopped_ = true;
+					}
+					condition_.notify_all();
+					driver_.join();
+				};
+
+				/** Execute command once after delay. */
+				inline TimerHandle Schedule(CommandPtrT command_p, const ClockT::duration delay_p) {
+					return Add(std::move(command_p), delay_p, ClockT::duration::zero());
+				};
+
+				/**
+				 * Execute command every period. First execution is after one period.
+				 * If driver is late, missed periods are coalesced in one execution.
+				 */
+				inline TimerHandle ScheduleEvery(CommandPtrT command_p, const ClockT::duration period_p) {
+					return Add(std::move(command_p), period_p, std::max(period_p, tick_));
+				};
+
+				/**
+				 * Remove scheduled command. O(1).
+				 * Periodic command, that is already collected for execution, is skipped.
+				 * Only the run, that is executing right now in driver thread, is not interrupted.
+				 * @return false, if command is already executed, cancelled or handle is invalid.
+				 */
+				bool Cancel(const TimerHandle handle_p) {
+					std::lock_guard lock{ mutex_ };
+					if (handle_p.index >= nodes_.size()) { return false; }
+					Node& node{ nodes_[handle_p.index] };
+					if (node.generation != handle_p.generation || node.bucket == kNull) { return false; }
+					Unlink(handle_p.index);
+					Release(handle_p.index);
+					return true;
+				};
+
+				/** Handler of exceptions from commands. By default exceptions are ignored. */
+				inline void set_error_handler(ErrorHandlerT error_handler_p) {
+					std::lock_guard lock{ mutex_ };
+					error_handler_ = std::move(error_handler_p);
+				};
+
+				/** Count of scheduled commands. */
+				inline size_t size() const {
+					std::lock_guard lock{ mutex_ };
+					return active_count_;
+				};
+
+				inline ClockT::duration tick() const noexcept { return tick_; };
+
+			private:
+				static constexpr std::uint32_t kNull{ std::numeric_limits<std::uint32_t>::max() };
+				static constexpr size_t kLevels{ 4 };
+				static constexpr size_t kSlotBits{ 8 };
+				static constexpr size_t kSlots{ 1 << kSlotBits };
+				static constexpr std::uint64_t kSlotMask{ kSlots - 1 };
+				static constexpr std::uint64_t kNever{ std::numeric_limits<std::uint64_t>::max() };
+
+				/** Expired command. Handle of periodic command is checked before execution, one shot has no handle. */
+				struct DueCommand {
+					CommandPtrT command;
+					TimerHandle handle{};
+				};
+
+				/** Timer. Nodes are stored in vector and linked in slots by indices. Free nodes are reused. */
+				struct Node {
+					CommandPtrT command{};
+					std::uint64_t deadline{};	// tick
+					std::uint64_t period{};		// ticks. 0 - one shot
+					std::uint32_t prev{ kNull };
+					std::uint32_t next{ kNull };	// next free node, if node is free
+					std::uint32_t bucket{ kNull };	// level * kSlots + slot. kNull - node is not in wheel
+					std::uint32_t generation{};
+				};
+
+				inline std::uint64_t TickOf(const ClockT::time_point time_p) const noexcept {
+					return static_cast<std::uint64_t>((time_p - start_time_) / tick_);
+				};
+
+				/** Duration in ticks rounded up. Minimum is 1 tick. */
+				inline std::uint64_t ToTicks(const ClockT::duration duration_p) const noexcept {
+					if (duration_p <= ClockT::duration::zero()) { return 1; }
+					return std::max<std::uint64_t>(static_cast<std::uint64_t>((duration_p + tick_ - ClockT::duration(1)) / tick_), 1);
+				};
+
+				TimerHandle Add(CommandPtrT command_p, const ClockT::duration delay_p, const ClockT::duration period_p) {
+					const ClockT::time_point now{ ClockT::now() };
+					std::unique_lock lock{ mutex_ };
+					const bool was_empty{ active_count_ == 0 };
+					if (was_empty) { current_tick_ = std::max(current_tick_, TickOf(now)); } // no timers to advance
+
+					const std::uint32_t index{ Allocate() };
+					Node& node{ nodes_[index] };
+					node.command = std::move(command_p);
+					// +1: current tick is partly passed, so command is never executed earlier than delay
+					node.deadline = std::max(TickOf(now) + ToTicks(delay_p) + 1, current_tick_ + 1);
+					node.period = period_p > ClockT::duration::zero() ? ToTicks(period_p) : 0;
+					Insert(index);
+					++active_count_;
+					const TimerHandle handle{ index, node.generation };
+					const bool is_earlier{ node.deadline < wake_tick_ };	// driver sleeps longer than needed
+
+					lock.unlock();
+					if (was_empty || is_earlier) { condition_.notify_one(); }
+					return handle;
+				};
+
+				std::uint32_t Allocate() {
+					if (free_head_ != kNull) {
+						const std::uint32_t index{ free_head_ };
+						free_head_ = nodes_[index].next;
+						nodes_[index].next = kNull;
+						return index;
+					}
+					nodes_.emplace_back();
+					return static_cast<std::uint32_t>(nodes_.size() - 1);
+				};
+
+				/** Node is returned to free list. Old handles become invalid. */
+				void Release(const std::uint32_t index) noexcept {
+					Node& node{ nodes_[index] };
+					node.command.reset();
+					node.bucket = kNull;
+					node.prev = kNull;
+					node.next = free_head_;
+					++node.generation;
+					free_head_ = index;
+					--active_count_;
+				};
+
+				/** Put node to the slot by its deadline. O(1). */
+				void Insert(const std::uint32_t index) noexcept {
+					Node& node{ nodes_[index] };
+					const std::uint64_t delta{ node.deadline > current_tick_ ? node.deadline - current_tick_ : 0 };
+					size_t level{};
+					while (level < kLevels - 1 && delta >= (std::uint64_t{ 1 } << (kSlotBits * (level + 1)))) { ++level; }
+
+					std::uint64_t slot{};
+					if (delta >= (std::uint64_t{ 1 } << (kSlotBits * kLevels))) {
+						slot = ((current_tick_ >> (kSlotBits * level)) + kSlotMask) & kSlotMask; // the farthest slot
+					} else {
+						slot = (node.deadline >> (kSlotBits * level)) & kSlotMask;
+					}
+
+					node.bucket = static_cast<std::uint32_t>(level * kSlots + slot);
+					node.prev = kNull;
+					node.next = buckets_[node.bucket];
+					if (node.next != kNull) { nodes_[node.next].prev = index; }
+					buckets_[node.bucket] = index;
+				};
+
+				/** Remove node from its slot. O(1). */
+				void Unlink(const std::uint32_t index) noexcept {
+					Node& node{ nodes_[index] };
+					if (node.prev != kNull) {
+						nodes_[node.prev].next = node.next;
+					} else {
+						buckets_[node.bucket] = node.next;
+					}
+					if (node.next != kNull) { nodes_[node.next].prev = node.prev; }
+					node.prev = node.next = kNull;
+				};
+
+				/** Move all nodes from slot of upper level to lower levels. */
+				void Cascade(const size_t level, const std::uint64_t slot) noexcept {
+					std::uint32_t index{ buckets_[level * kSlots + slot] };
+					buckets_[level * kSlots + slot] = kNull;
+					while (index != kNull) {
+						const std::uint32_t next{ nodes_[index].next };
+						Insert(index);
+						index = next;
+					}
+				};
+
+				/**
+				 * Advance wheel to target tick. Collect commands of all expired ticks in one batch.
+				 * Periodic command is collected once per batch.
+				 */
+				void AdvanceTo(const std::uint64_t target_tick, std::vector<DueCommand>& due_p) {
+					while (current_tick_ < target_tick && active_count_ > 0) {
+						++current_tick_;
+						for (size_t level{ 1 }; level < kLevels; ++level) {	// cascade, when lower level made full turn
+							if ((current_tick_ & ((std::uint64_t{ 1 } << (kSlotBits * level)) - 1)) != 0) { break; }
+							Cascade(level, (current_tick_ >> (kSlotBits * level)) & kSlotMask);
+						}
+
+						std::uint32_t index{ buckets_[current_tick_ & kSlotMask] };
+						buckets_[current_tick_ & kSlotMask] = kNull;
+						while (index != kNull) {
+							Node& node{ nodes_[index] };
+							const std::uint32_t next{ node.next };
+							if (node.deadline > current_tick_) {	// farthest slot of level 0 after cascade
+								Insert(index);
+							} else if (node.period != 0) {
+								node.deadline += node.period;
+								if (node.deadline <= target_tick) {	// coalesce missed periods
+									node.deadline += ((target_tick - node.deadline) / node.period + 1) * node.period;
+								}
+								due_p.push_back(DueCommand{ node.command, TimerHandle{ index, node.generation } });
+								Insert(index);
+							} else {
+								due_p.push_back(DueCommand{ std::move(node.command) });
+								Release(index);
+							}
+							index = next;
+						}
+					}
+					current_tick_ = std::max(current_tick_, target_tick);
+				};
+
+				/**
+				 * The nearest tick, when driver has work: the first not empty slot of level 0
+				 * or the end of level 0 turn, when upper level is cascaded. Level 0 is scanned at most once.
+				 */
+				std::uint64_t NextEventTick() const noexcept {
+					const std::uint64_t turn_end{ (current_tick_ | kSlotMask) + 1 };
+					for (std::uint64_t tick{ current_tick_ + 1 }; tick < turn_end; ++tick) {
+						if (buckets_[tick & kSlotMask] != kNull) { return tick; }
+					}
+					return turn_end;
+				};
+
+				/** Periodic command may be cancelled after it was collected. */
+				bool IsCancelled(const TimerHandle handle_p) const {
+					if (handle_p.index == kNull) { return false; }
+					std::lock_guard lock{ mutex_ };
+					return nodes_[handle_p.index].generation != handle_p.generation;
+				};
+
+				void DriverLoop() {
+					std::vector<DueCommand> due{};
+					std::unique_lock lock{ mutex_ };
+					while (!is_stopped_) {
+						if (active_count_ == 0) {
+							condition_.wait(lock, [this]() { return is_stopped_ || active_count_ > 0; });
+							continue;
+						}
+						// Sleep until the next expired slot or cascade. Add of earlier timer wakes driver
+						wake_tick_ = NextEventTick();
+						const ClockT::time_point wake_time{ start_time_ + tick_ * static_cast<ClockT::rep>(wake_tick_) };
+						condition_.wait_until(lock, wake_time);
+						wake_tick_ = kNever;
+						if (is_stopped_) { break; }
+
+						AdvanceTo(TickOf(ClockT::now()), due);
+						if (due.empty()) { continue; }
+						const ErrorHandlerT error_handler{ error_handler_ };
+
+						lock.unlock();
+						for (DueCommand& due_command : due) {
+							if (IsCancelled(due_command.handle)) { continue; }
+							try {
+								due_command.command->Execute();
+							} catch (...) {
+								if (error_handler) { error_handler(std::current_exception()); }
+							}
+						}
+						due.clear();
+						lock.lock();
+					}
+				};
+
+// Data
+				const ClockT::duration tick_;
+				const ClockT::time_point start_time_;
+
+				mutable std::mutex mutex_{};
+				std::condition_variable condition_{};
+				bool is_stopped_{};
+				ErrorHandlerT error_handler_{};
+
+				std::array<std::uint32_t, kLevels * kSlots> buckets_{};
+				std::vector<Node> nodes_{};
+				std::uint32_t free_head_{ kNull };
+				std::uint64_t current_tick_{};
+				std::uint64_t wake_tick_{ kNever };	// driver sleeps until this tick. kNever - driver doesn't sleep by timer
+				size_t active_count_{};
+
+				std::thread driver_{};	// the last, thread uses other data members
+
+				/*
+				* Class Design:
+				* Nodes are linked by indices in one vector, so timers don't allocate after warm up
+				* and handles stay valid after reallocation of vector.
+				* Generation in handle protects from cancellation of reused node.
+				* Driver doesn't wake up on every tick: it sleeps until the next not empty slot of level 0
+				* or cascade of upper level.
+				*/
+
+			}; // !class SchedulingInvoker
+
+		} // !namespace command_scheduler
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !SCHEDULED_COMMAND_HPP
@@ -2,8 +2,12 @@
 #define MEMENTO_HPP
 
 
+#include <algorithm>
 #include <concepts>
+#include <cstddef>
+#include <limits>
 #include <memory>
+#include <new>
 #include <utility>
 
 
@@ -31,6 +35,28 @@ namespace pattern {
             template<typename ConcreteOriginatorT, typename OriginatorStateT>
 			class AbstractOriginator;
 
+			template<typename ConcreteOriginatorT, typename OriginatorStateT>
+			class StaticOriginator;
+
+			/** State, that holds memory outside of object, f.e. in std::vector. */
+			template<typename OriginatorStateT>
+			concept StateWithDynamicSize = requires(const OriginatorStateT& state) {
+				{ state.DynamicSizeInBytes() } -> std::convertible_to<size_t>;
+			};
+
+			/**
+			 * State, that shares memory with its copies, f.e. copy-on-write state.
+			 * DynamicSizeInBytes() is memory, that the version of state added to the version, it was copied from.
+			 * DynamicSizeInBytesSince(older) is the same, but 0 for the same version as older.
+			 * TotalDynamicSizeInBytes() is all memory, that is referenced by state.
+			 */
+			template<typename OriginatorStateT>
+			concept StateWithSharedSize = StateWithDynamicSize<OriginatorStateT>
+				&& requires(const OriginatorStateT& state, const OriginatorStateT& older) {
+				{ state.DynamicSizeInBytesSince(older) } -> std::convertible_to<size_t>;
+				{ state.TotalDynamicSizeInBytes() } -> std::convertible_to<size_t>;
+			};
+
 			/**
 			 * Can be used only by class derived from AbstractOriginator and only by owner object, created memento.
 			 * Memento must use only Concrete Originator, not abstract interface.
@@ -44,6 +70,7 @@ namespace pattern {
 
 				friend ConcreteOriginatorT;
 				friend AbstractOriginator<ConcreteOriginatorT, OriginatorStateT>;
+				friend StaticOriginator<ConcreteOriginatorT, OriginatorStateT>;
 
 				Memento() = delete;	// Must be created only by Concrete Originator
 				Memento(const Memento&) = delete;	// Polymorphic suppress Copy & Move
@@ -93,6 +120,28 @@ namespace pattern {
 					return MementoT{ owner_, memento_state_ };
                 };
 
+				/**
+				 * Memory, that is hold by memento. Is used for memory budget of CareTaker.
+				 * Define DynamicSizeInBytes() in OriginatorStateT, if state holds memory outside of object.
+				 */
+				inline size_t SizeInBytes() const noexcept {
+					if constexpr (StateWithDynamicSize<OriginatorStateT>) {
+						return sizeof(MementoT) + static_cast<size_t>(memento_state_.DynamicSizeInBytes());
+					} else {
+						return sizeof(MementoT);
+					}
+				};
+
+				/** Memory, that is not shared with older memento. Is used by CareTakerRing. */
+				inline size_t SizeInBytesSince(const MementoT& older_p) const noexcept requires StateWithSharedSize<OriginatorStateT> {
+					return sizeof(MementoT) + static_cast<size_t>(memento_state_.DynamicSizeInBytesSince(older_p.memento_state_));
+				};
+
+				/** All memory, that is referenced by memento, including shared with other mementos. */
+				inline size_t TotalSizeInBytes() const noexcept requires StateWithSharedSize<OriginatorStateT> {
+					return sizeof(MementoT) + static_cast<size_t>(memento_state_.TotalDynamicSizeInBytes());
+				};
+
 			private:	// Private Interface is closed for all classes except owner ConcreteOriginatorT
 
 				/**
@@ -231,6 +280,75 @@ namespace pattern {
 					return std::make_unique<MementoT>(GetConcreteOriginatorCRef(), GetOriginatorStateCRef());
 				};
 
+				/**
+				 * Create Memento from State of Originator inside of storage of CareTaker, f.e. CareTakerRing.
+				 * No heap allocation for Memento.
+				 * Creating memento by moving from temporary OriginatorStateT object.
+				 *
+				 * @return reference to created memento inside of care_taker_p
+				 */
+				template<typename CareTakerT>
+				MementoT& CreateMementoIn(CareTakerT& care_taker_p) const {
+					return care_taker_p.Emplace(GetConcreteOriginatorCRef(), GetOriginatorStateValue());
+				};
+
+				/**
+				 * Capture State of Originator in calling thread and process it on executor, f.e. memento_async::SnapshotWorker.
+				 * Capture is a copy of State: use copy-on-write state, f.e. memento_cow::CowVector, so it is O(1)
+				 * and the writer resumes immediately. Serialization or compression in process_p doesn't block the writer.
+				 *
+				 * @param process_p	callable(OriginatorStateT&&), is executed on background thread
+				 * @return future of result of process_p
+				 */
+				template<typename ExecutorT, typename ProcessT>
+				auto CreateMementoAsync(ExecutorT& executor_p, ProcessT process_p) const {
+					return executor_p.Submit([state = GetOriginatorStateValue(), process = std::move(process_p)]() mutable {
+						return process(std::move(state));
+					});
+				};
+
+				/**
+				 * Capture State of Originator in calling thread and create Memento on executor.
+				 *
+				 * @return future of unique_ptr Memento
+				 */
+				template<typename ExecutorT>
+				auto CreateMementoAsync(ExecutorT& executor_p) const {
+					return CreateMementoAsync(executor_p, [&owner = GetConcreteOriginatorCRef()](OriginatorStateT&& state_p) {
+						return std::make_unique<MementoT>(owner, std::move(state_p));
+					});
+				};
+
+				/**
+				 * Pass const reference to State of Originator to CareTaker, that makes its own snapshot,
+				 * f.e. DeltaCareTaker stores only changes since previous snapshot, MementoPool copies state to free slot.
+				 * Use, when there is whole OriginatorStateT object inside of Originator.
+				 * No Additional temporary object OriginatorStateT construction.
+				 *
+				 * @return result of CareTaker, f.e. handle of snapshot in MementoPool
+				 */
+				template<typename CareTakerT>
+				decltype(auto) CreateSnapshotIn(CareTakerT& care_taker_p) const {
+					return care_taker_p.Emplace(GetConcreteOriginatorCRef(), GetOriginatorStateCRef());
+				};
+
+				/**
+				 * Restore State of Originator from snapshot of CareTaker, that reconstructs state,
+				 * f.e. DeltaCareTaker or MementoPool. You can disable owner check.
+				 *
+				 * @param key_p	key of snapshot in CareTaker: n-th most recent for history, handle for pool
+				 * @return true if originator is the owner of snapshot and snapshot exists
+				 */
+				template<typename CareTakerT, typename KeyT = size_t>
+				bool RestoreFrom(const CareTakerT& care_taker_p, const KeyT& key_p = KeyT{}, bool to_check_owner = true) {
+					auto state{ care_taker_p.Reconstruct(GetConcreteOriginatorCRef(), key_p, to_check_owner) };
+					if (state) {
+						SetOriginatorState(std::move(*state));
+						return true;
+					}
+					return false;
+				};
+
 
 				/**
 				 * Restore State of Originator from Memento using copy operation.
@@ -318,6 +436,144 @@ namespace pattern {
 			}; // !class AbstractOriginator
 
 
+			/**
+			 * Abstract. Stateless. CRTP variant of AbstractOriginator with the same interface.
+			 * Concrete Originator is resolved at compile time: no dynamic_cast, no virtual calls,
+			 * so creation and restoring of memento in tight loops can be inlined.
+			 * Is used for public inheritance to ConcreteOriginator class.
+			 *
+			 * How to use: define in ConcreteOriginator non virtual functions SetOriginatorState(),
+			 * GetOriginatorStateValue() and if needed GetOriginatorStateCRef(), SetOriginatorState(&&).
+			 * If they are not public, declare StaticOriginator<ConcreteOriginatorT, OriginatorStateT> as friend.
+			 *
+			 * @param ConcreteOriginatorT Concrete Originator type, derived from this class
+			 */
+			template<typename ConcreteOriginatorT, typename OriginatorStateT>
+			class StaticOriginator {
+			public:
+				using MementoT = Memento<ConcreteOriginatorT, OriginatorStateT>;
+				using MementoPtr = std::unique_ptr<MementoT>;
+
+			protected:
+				StaticOriginator() = default;
+				StaticOriginator(const StaticOriginator&) = delete; // Memento holds reference to owner, suppress Copy, Move
+				StaticOriginator& operator=(const StaticOriginator&) = delete;
+				StaticOriginator(StaticOriginator&&) noexcept = delete;
+				StaticOriginator& operator=(StaticOriginator&&) noexcept = delete;
+				~StaticOriginator() = default;	// Non virtual, object is never deleted by pointer to base
+
+			public:
+				/** Create Memento from State of Originator. Default Creation is by CreateMementoByValue. */
+				inline MementoT CreateMemento() const { return CreateMementoByValue(); };
+
+				/** Create Memento by moving from temporary OriginatorStateT object. */
+				inline MementoT CreateMementoByValue() const {
+					return MementoT(Concrete(), Concrete().GetOriginatorStateValue());
+				};
+
+				/** Create unique_ptr Memento by moving from temporary OriginatorStateT object. */
+				inline MementoPtr CreateMementoPtrByValue() const {
+					return std::make_unique<MementoT>(Concrete(), Concrete().GetOriginatorStateValue());
+				};
+
+				/** Create Memento by coping from const reference to OriginatorStateT object inside Originator. */
+				inline MementoT CreateMementoByCRef() const {
+					return MementoT(Concrete(), Concrete().GetOriginatorStateCRef());
+				};
+
+				/** Create unique_ptr Memento by coping from const reference to OriginatorStateT object inside Originator. */
+				inline MementoPtr CreateMementoPtrByCRef() const {
+					return std::make_unique<MementoT>(Concrete(), Concrete().GetOriginatorStateCRef());
+				};
+
+				/** Create Memento inside of storage of CareTaker, f.e. CareTakerRing. */
+				template<typename CareTakerT>
+				inline MementoT& CreateMementoIn(CareTakerT& care_taker_p) const {
+					return care_taker_p.Emplace(Concrete(), Concrete().GetOriginatorStateValue());
+				};
+
+				/**
+				 * Capture State of Originator in calling thread and process it on executor, f.e. memento_async::SnapshotWorker.
+				 * @return future of result of process_p(OriginatorStateT&&)
+				 */
+				template<typename ExecutorT, typename ProcessT>
+				auto CreateMementoAsync(ExecutorT& executor_p, ProcessT process_p) const {
+					return executor_p.Submit([state = Concrete().GetOriginatorStateValue(), process = std::move(process_p)]() mutable {
+						return process(std::move(state));
+					});
+				};
+
+				/** Capture State of Originator in calling thread and create Memento on executor. */
+				template<typename ExecutorT>
+				auto CreateMementoAsync(ExecutorT& executor_p) const {
+					return CreateMementoAsync(executor_p, [&owner = Concrete()](OriginatorStateT&& state_p) {
+						return std::make_unique<MementoT>(owner, std::move(state_p));
+					});
+				};
+
+				/** Pass const reference to State of Originator to CareTaker, that makes its own snapshot. */
+				template<typename CareTakerT>
+				inline decltype(auto) CreateSnapshotIn(CareTakerT& care_taker_p) const {
+					return care_taker_p.Emplace(Concrete(), Concrete().GetOriginatorStateCRef());
+				};
+
+				/**
+				 * Restore State of Originator from snapshot of CareTaker, that reconstructs state.
+				 *
+				 * @param key_p	key of snapshot in CareTaker: n-th most recent for history, handle for pool
+				 * @return true if originator is the owner of snapshot and snapshot exists
+				 */
+				template<typename CareTakerT, typename KeyT = size_t>
+				bool RestoreFrom(const CareTakerT& care_taker_p, const KeyT& key_p = KeyT{}, bool to_check_owner = true) {
+					auto state{ care_taker_p.Reconstruct(Concrete(), key_p, to_check_owner) };
+					if (state) {
+						Concrete().SetOriginatorState(std::move(*state));
+						return true;
+					}
+					return false;
+				};
+
+				/**
+				 * Restore State of Originator from Memento using copy operation.
+				 * @return true if originator is the owner of memento
+				 */
+				inline bool RestoreByCopy(const MementoT& memento_p, bool to_check_owner = true) {
+					const std::pair<const OriginatorStateT&, bool>
+						get_state_res{ memento_p.get_state_cref(Concrete(), to_check_owner) };
+					if (get_state_res.second) {
+						Concrete().SetOriginatorState(get_state_res.first);
+						return true;
+					}
+					return false;
+				};
+
+				/**
+				 * Restore State of Originator from moved state of Memento.
+				 * If there is no SetOriginatorState(&&), state is copied.
+				 * @return true if originator is the owner of memento
+				 */
+				inline bool RestoreByMove(MementoT&& memento_p, bool to_check_owner = true) {
+					std::pair<OriginatorStateT&&, bool>
+						get_state_res{ memento_p.get_state_rvref(Concrete(), to_check_owner) };
+					if (get_state_res.second) {
+						Concrete().SetOriginatorState(std::move(get_state_res.first));
+						return true;
+					}
+					return false;
+				};
+
+			private:
+				/** Downcast at compile time. */
+				inline const ConcreteOriginatorT& Concrete() const noexcept {
+					return static_cast<const ConcreteOriginatorT&>(*this);
+				};
+				inline ConcreteOriginatorT& Concrete() noexcept {
+					return static_cast<ConcreteOriginatorT&>(*this);
+				};
+
+			}; // !class StaticOriginator
+
+
 
             /** Concrete State as interesting part of Originator. Part or whole object. */
             struct MyMementoState {
@@ -369,6 +625,41 @@ namespace pattern {
 			};
 
 
+			/** The same as MyOriginator, but with static dispatch. */
+			class MyStaticOriginator final : public StaticOriginator<MyStaticOriginator, MyMementoState> {
+				friend StaticOriginator<MyStaticOriginator, MyMementoState>;
+
+			public:
+				MyStaticOriginator() = default;
+				MyStaticOriginator(const MyStaticOriginator&) = delete; // Memento holds reference to owner, suppress Copy, Move
+				MyStaticOriginator& operator=(const MyStaticOriginator&) = delete;
+				MyStaticOriginator(MyStaticOriginator&&) noexcept = delete;
+				MyStaticOriginator& operator=(MyStaticOriginator&&) noexcept = delete;
+				~MyStaticOriginator() = default;
+
+			protected:
+				inline void SetOriginatorState(const MyMementoState& memento_state_p) {
+					state_ = memento_state_p;
+				};
+
+				inline void SetOriginatorState(MyMementoState&& memento_state_p) {
+					state_ = std::move(memento_state_p);
+				};
+
+				inline MyMementoState GetOriginatorStateValue() const {
+					return state_;
+				};
+
+				inline const MyMementoState& GetOriginatorStateCRef() const {
+					return state_;
+				};
+
+			public:
+				MyMementoState state_{};
+				int c{};
+			};
+
+
 			template<typename ConcreteOriginatorT, typename OriginatorStateT>
 			class CareTaker final {
 			public:
@@ -388,6 +679,135 @@ namespace pattern {
 			};
 
 
+			/**
+			 * CareTaker with history of mementos. Fixed-capacity ring of mementos in contiguous storage.
+			 * Mementos are created in place by AbstractOriginator::CreateMementoIn, so there is
+			 * no heap allocation per memento.
+			 * When capacity or byte budget is exceeded, the oldest mementos are evicted.
+			 * The newest memento is never evicted by byte budget.
+			 * Memento with StateWithSharedSize is charged only for memory, that is not shared with the previous memento,
+			 * and the oldest one is charged in full. So shared memory is charged once, to the oldest memento, that references it.
+			 * Access to n-th most recent memento is O(1).
+			 */
+			template<typename ConcreteOriginatorT, typename OriginatorStateT>
+			class CareTakerRing final {
+			public:
+				using MementoT = Memento<ConcreteOriginatorT, OriginatorStateT>;
+
+				/**
+				 * @param capacity_p		max count of mementos. Minimum is 1.
+				 * @param bytes_budget_p	max sum of Memento::SizeInBytes() of all mementos.
+				 */
+				explicit CareTakerRing(const size_t capacity_p,
+									   const size_t bytes_budget_p = std::numeric_limits<size_t>::max())
+					: capacity_{ std::max<size_t>(capacity_p, 1) },
+					  slots_{ std::make_unique<Slot[]>(capacity_) },
+					  bytes_budget_{ bytes_budget_p } {
+				};
+
+				CareTakerRing(const CareTakerRing&) = delete;	// Mementos are bound to addresses in slots
+				CareTakerRing& operator=(const CareTakerRing&) = delete;
+				CareTakerRing(CareTakerRing&&) noexcept = delete;
+				CareTakerRing& operator=(CareTakerRing&&) noexcept = delete;
+				~CareTakerRing() { Clear(); };
+
+				/**
+				 * Construct memento in place as the newest one.
+				 * Is used by AbstractOriginator::CreateMementoIn.
+				 */
+				template<typename... ArgTs>
+				MementoT& Emplace(ArgTs&&... args_p) {
+					if (size_ == capacity_) { PopOldest(); }
+					Slot& slot{ slots_[Index(size_)] };
+					MementoT* memento{ ::new (static_cast<void*>(slot.storage)) MementoT(std::forward<ArgTs>(args_p)...) };
+					if constexpr (StateWithSharedSize<OriginatorStateT>) {
+						slot.size_in_bytes = size_ == 0 ? memento->TotalSizeInBytes() : memento->SizeInBytesSince(*Get());
+					} else {
+						slot.size_in_bytes = memento->SizeInBytes();
+					}
+					bytes_ += slot.size_in_bytes;
+					++size_;
+					while (bytes_ > bytes_budget_ && size_ > 1) { PopOldest(); }
+					return *memento;
+				};
+
+				/**
+				 * Get n-th most recent memento. O(1).
+				 *
+				 * @param n_recent 0 - the newest memento.
+				 * @return nullptr, if there is no such memento.
+				 */
+				inline MementoT* Get(const size_t n_recent = 0) noexcept {
+					return n_recent < size_ ? At(Index(size_ - 1 - n_recent)) : nullptr;
+				};
+				inline const MementoT* Get(const size_t n_recent = 0) const noexcept {
+					return n_recent < size_ ? At(Index(size_ - 1 - n_recent)) : nullptr;
+				};
+
+				/** Delete the newest memento, f.e. after undo. */
+				void PopNewest() noexcept {
+					if (size_ == 0) { return; }
+					Destroy(Index(size_ - 1));
+					--size_;
+				};
+
+				/** Delete the oldest memento. */
+				void PopOldest() noexcept {
+					if (size_ == 0) { return; }
+					Destroy(head_);
+					head_ = Index(1);
+					--size_;
+					if constexpr (StateWithSharedSize<OriginatorStateT>) {
+						if (size_ > 0) {	// new oldest is charged for memory, it shared with the evicted one
+							Slot& oldest{ slots_[head_] };
+							bytes_ -= oldest.size_in_bytes;
+							oldest.size_in_bytes = At(head_)->TotalSizeInBytes();
+							bytes_ += oldest.size_in_bytes;
+						}
+					}
+				};
+
+				void Clear() noexcept {
+					while (size_ > 0) { PopNewest(); }
+					head_ = 0;
+				};
+
+				inline size_t size() const noexcept { return size_; };
+				inline size_t capacity() const noexcept { return capacity_; };
+				inline bool empty() const noexcept { return size_ == 0; };
+				inline size_t size_in_bytes() const noexcept { return bytes_; };
+				inline size_t bytes_budget() const noexcept { return bytes_budget_; };
+
+			private:
+				/** Raw storage for one memento. */
+				struct Slot {
+					alignas(MementoT) std::byte storage[sizeof(MementoT)];
+					size_t size_in_bytes{};
+				};
+
+				/** Ring position of n-th memento from the oldest */
+				inline size_t Index(const size_t n) const noexcept { return (head_ + n) % capacity_; };
+
+				inline MementoT* At(const size_t index) const noexcept {
+					return std::launder(reinterpret_cast<MementoT*>(slots_[index].storage));
+				};
+
+				void Destroy(const size_t index) noexcept {
+					At(index)->~MementoT();
+					bytes_ -= slots_[index].size_in_bytes;
+					slots_[index].size_in_bytes = 0;
+				};
+
+// Data
+				size_t capacity_;
+				std::unique_ptr<Slot[]> slots_;
+				size_t head_{};
+				size_t size_{};
+				size_t bytes_{};
+				size_t bytes_budget_;
+			}; // !class CareTakerRing
+
+
 			/**
 			 * Abstract. Stateless. Interface for class, whose state will be saved and restored.
 			 * Memento must use only Concrete Originator, not interface.
@@ -0,0 +1,112 @@
+﻿#ifndef ASYNC_MEMENTO_HPP
+#define ASYNC_MEMENTO_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "behavioral/memento.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace memento_async {
+			// Background snapshots for periodic autosave of large states.
+			// AbstractOriginator::CreateMementoAsync(worker, process) captures State of Originator in calling thread
+			// and passes it to process on background thread: serialization, compression, writing to disk.
+			// Capture is a copy of State. Use copy-on-write state (memento_cow::CowVector), so capture is O(1)
+			// and the writer thread resumes immediately. Chunks, mutated by writer after capture, are duplicated,
+			// so background thread sees consistent frozen view.
+			//
+			// How to use:
+			// SnapshotWorker worker{};
+			// std::future<std::string> saved{ editor.CreateMementoAsync(worker, Serialize) };
+
+
+			/**
+			 * One background thread, that executes snapshot tasks in order of submission.
+			 * Destructor finishes all submitted tasks, so autosave is not lost on shutdown.
+			 */
+			class SnapshotWorker final {
+			public:
+				SnapshotWorker() : worker_{ [this]() { WorkerLoop(); } } {};
+
+				SnapshotWorker(const SnapshotWorker&) = delete;
+				SnapshotWorker& operator=(const SnapshotWorker&) = delete;
+				SnapshotWorker(SnapshotWorker&&) noexcept = delete;
+				SnapshotWorker& operator=(SnapshotWorker&&) noexcept = delete;
+
+				~SnapshotWorker() {
+					{
+						std::lock_guard lock{ mutex_ };
+						is_stopped_ = true;
+					}
+					condition_.notify_all();
+					worker_.join();
+				};
+
+				/**
+				 * Execute task on background thread.
+				 * Exception of task is stored in future.
+				 */
+				template<typename TaskT>
+				std::future<std::invoke_result_t<std::decay_t<TaskT>&>> Submit(TaskT&& task_p) {
+					using ResultT = std::invoke_result_t<std::decay_t<TaskT>&>;
+					auto task{ std::make_shared<std::packaged_task<ResultT()>>(std::forward<TaskT>(task_p)) };
+					std::future<ResultT> result{ task->get_future() };
+					{
+						std::lock_guard lock{ mutex_ };
+						queue_.emplace_back([task]() { (*task)(); });
+					}
+					condition_.notify_one();
+					return result;
+				};
+
+				/** Count of tasks, that are not finished. */
+				inline size_t pending() const {
+					std::lock_guard lock{ mutex_ };
+					return queue_.size() + (is_busy_ ? 1 : 0);
+				};
+
+			private:
+				void WorkerLoop() {
+					std::unique_lock lock{ mutex_ };
+					while (true) {
+						condition_.wait(lock, [this]() { return is_stopped_ || !queue_.empty(); });
+						if (queue_.empty()) { return; }	// stopped and drained
+
+						std::function<void()> task{ std::move(queue_.front()) };
+						queue_.pop_front();
+						is_busy_ = true;
+						lock.unlock();
+						task();	// packaged_task stores exception in future
+						lock.lock();
+						is_busy_ = false;
+					}
+				};
+
+// Data
+				mutable std::mutex mutex_{};
+				std::condition_variable condition_{};
+				std::deque<std::function<void()>> queue_{};
+				bool is_busy_{};
+				bool is_stopped_{};
+
+				std::thread worker_;	// the last, thread uses other data members
+
+			}; // !class SnapshotWorker
+
+		} // !namespace memento_async
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !ASYNC_MEMENTO_HPP
@@ -0,0 +1,223 @@
+﻿#ifndef COW_MEMENTO_HPP
+#define COW_MEMENTO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "behavioral/memento.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace memento_cow {
+			// Copy-on-write memento state. State is split in refcounted chunks. Copy of state shares
+			// all chunks, so snapshot is O(1). Mutation duplicates only the touched chunk, if it is shared.
+			// https://en.wikipedia.org/wiki/Persistent_data_structure
+			//
+			// How to use: keep CowVector as state of Originator and create mementos by const reference,
+			// f.e. CreateMementoByCRef() or CreateMementoIn(care_taker_ring).
+			// N snapshots of large state cost N chunk tables + chunks, mutated between snapshots.
+
+
+			/**
+			 * Vector with structural sharing. Two levels: shared table of pointers to shared chunks.
+			 * Copy is O(1): only table pointer is copied.
+			 * First mutation after copy duplicates table (O(size / chunk_size) pointers) and the touched chunk.
+			 * Next mutations of the same chunk are in place.
+			 *
+			 * Not thread safe for concurrent access to one object. Different copies may be used
+			 * by different threads.
+			 *
+			 * @param ValueT		copy constructible value type
+			 * @param kChunkSize	count of values in chunk. By default chunk is about 4 KiB.
+			 */
+			template<typename ValueT, size_t kChunkSize = std::max<size_t>(4096 / sizeof(ValueT), 1)>
+			class CowVector final {
+			public:
+				static_assert(kChunkSize > 0, "Chunk must hold at least one value");
+
+				using value_type = ValueT;
+				using size_type = size_t;
+
+				CowVector() = default;
+				CowVector(const size_t size_p, const ValueT& value_p = ValueT{}) { resize(size_p, value_p); };
+				CowVector(std::initializer_list<ValueT> values_p) {
+					for (const ValueT& value : values_p) { push_back(value); }
+				};
+
+				/** O(1). Chunks are shared. */
+				CowVector(const CowVector&) = default;
+				CowVector& operator=(const CowVector&) = default;
+				CowVector(CowVector&& other) noexcept
+					: table_{ std::move(other.table_) }, size_{ std::exchange(other.size_, 0) },
+					  added_bytes_{ std::exchange(other.added_bytes_, 0) } {
+				};
+				CowVector& operator=(CowVector&& other) noexcept {
+					table_ = std::move(other.table_);
+					size_ = std::exchange(other.size_, 0);
+					added_bytes_ = std::exchange(other.added_bytes_, 0);
+					return *this;
+				};
+				~CowVector() = default;
+
+				inline const ValueT& operator[](const size_t index) const noexcept {
+					return (*(*table_)[index / kChunkSize])[index % kChunkSize];
+				};
+
+				const ValueT& at(const size_t index) const {
+					if (index >= size_) { throw std::out_of_range("CowVector index is out of range"); }
+					return (*this)[index];
+				};
+
+				/**
+				 * Mutable access. Duplicates chunk, if it is shared with copy.
+				 * Reference is valid until next copy of this object.
+				 */
+				ValueT& Mutable(const size_t index) {
+					return (*MutableChunk(index / kChunkSize))[index % kChunkSize];
+				};
+
+				inline void Set(const size_t index, ValueT value_p) { Mutable(index) = std::move(value_p); };
+
+				void push_back(ValueT value_p) {
+					if (size_ % kChunkSize == 0) {
+						TableT& table{ MutableTable() };
+						const size_t table_capacity{ table.capacity() };
+						table.push_back(std::make_shared<ChunkT>());
+						table.back()->reserve(kChunkSize);
+						added_bytes_ += (table.capacity() - table_capacity) * sizeof(ChunkPtrT) + kChunkBytes;
+					}
+					MutableChunk(size_ / kChunkSize)->push_back(std::move(value_p));
+					++size_;
+				};
+
+				void pop_back() {
+					if (size_ == 0) { return; }
+					--size_;
+					if (size_ % kChunkSize == 0) {
+						MutableTable().pop_back();
+					} else {
+						MutableChunk(size_ / kChunkSize)->pop_back();
+					}
+				};
+
+				void resize(const size_t size_p, const ValueT& value_p = ValueT{}) {
+					while (size_ > size_p) { pop_back(); }
+					while (size_ < size_p) { push_back(value_p); }
+				};
+
+				void clear() noexcept {
+					table_.reset();
+					size_ = 0;
+					added_bytes_ = 0;
+				};
+
+				inline size_t size() const noexcept { return size_; };
+				inline bool empty() const noexcept { return size_ == 0; };
+				inline size_t chunk_count() const noexcept { return table_ ? table_->size() : 0; };
+				static constexpr size_t chunk_size() noexcept { return kChunkSize; };
+
+				/** Count of chunks, physically shared with other vector. */
+				size_t SharedChunksWith(const CowVector& other) const noexcept {
+					const size_t count{ std::min(chunk_count(), other.chunk_count()) };
+					if (count == 0 || table_ == other.table_) { return count; }
+					size_t shared{};
+					for (size_t i{}; i < count; ++i) { shared += ((*table_)[i] == (*other.table_)[i]) ? 1 : 0; }
+					return shared;
+				};
+
+				/**
+				 * Memory, that this version added to the version, it was copied from: its table and chunks,
+				 * allocated after the table stopped to be shared. Is used by Memento::SizeInBytes(). O(1).
+				 * Snapshot right after creation shares the version with Originator, so it is charged for edits since
+				 * the previous snapshot. Chunks, released by pop_back, are not subtracted: it is an upper bound.
+				 */
+				inline size_t DynamicSizeInBytes() const noexcept { return added_bytes_; };
+
+				/** DynamicSizeInBytes(), but 0 for the same version as older_p. Is used by CareTakerRing. O(1). */
+				inline size_t DynamicSizeInBytesSince(const CowVector& older_p) const noexcept {
+					return table_ == older_p.table_ ? 0 : added_bytes_;
+				};
+
+				/** All memory, that is referenced by this vector, including shared chunks. O(1). */
+				inline size_t TotalDynamicSizeInBytes() const noexcept {
+					return table_ ? table_->capacity() * sizeof(ChunkPtrT) + chunk_count() * kChunkBytes : 0;
+				};
+
+				friend bool operator==(const CowVector& lhs, const CowVector& rhs) {
+					if (lhs.size_ != rhs.size_) { return false; }
+					if (lhs.table_ == rhs.table_) { return true; }
+					for (size_t chunk{}; chunk < lhs.chunk_count(); ++chunk) {
+						if ((*lhs.table_)[chunk] != (*rhs.table_)[chunk] && *(*lhs.table_)[chunk] != *(*rhs.table_)[chunk]) {
+							return false;
+						}
+					}
+					return true;
+				};
+
+			private:
+				using ChunkT = std::vector<ValueT>;
+				using ChunkPtrT = std::shared_ptr<ChunkT>;
+				using TableT = std::vector<ChunkPtrT>;
+
+				/** Every chunk reserves kChunkSize values. */
+				static constexpr size_t kChunkBytes{ sizeof(ChunkT) + kChunkSize * sizeof(ValueT) };
+
+				/** Duplicate table of pointers, if it is shared. Chunks stay shared. */
+				TableT& MutableTable() {
+					if (!table_) {
+						table_ = std::make_shared<TableT>();
+						added_bytes_ = 0;
+					} else if (table_.use_count() > 1) {
+						table_ = std::make_shared<TableT>(*table_);
+						added_bytes_ = table_->capacity() * sizeof(ChunkPtrT);	// new version
+					} else {
+						std::atomic_thread_fence(std::memory_order_acquire);	// see Class Design
+					}
+					return *table_;
+				};
+
+				/** Duplicate chunk, if it is shared. */
+				ChunkPtrT& MutableChunk(const size_t chunk_index) {
+					ChunkPtrT& chunk{ MutableTable()[chunk_index] };
+					if (chunk.use_count() > 1) {
+						ChunkPtrT copy{ std::make_shared<ChunkT>() };
+						copy->reserve(kChunkSize);
+						copy->assign(chunk->begin(), chunk->end());
+						chunk = std::move(copy);
+						added_bytes_ += kChunkBytes;
+					} else {
+						std::atomic_thread_fence(std::memory_order_acquire);
+					}
+					return chunk;
+				};
+
+// Data
+				std::shared_ptr<TableT> table_{};
+				size_t size_{};
+				size_t added_bytes_{};	// is copied with table_, so it is a property of version
+
+				/*
+				* Class Design:
+				* Uniqueness is checked by use_count(). If copy in other thread is destroyed concurrently,
+				* use_count() may be stale and chunk is duplicated once more than needed, that is safe.
+				* Acquire fence after use_count() == 1 synchronizes with release of the last copy in other thread,
+				* so its reads of chunk happen before writes of this thread. F.e. background snapshot.
+				*/
+
+			}; // !class CowVector
+
+		} // !namespace memento_cow
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !COW_MEMENTO_HPP
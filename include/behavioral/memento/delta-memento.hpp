@@ -0,0 +1,259 @@
+﻿#ifndef DELTA_MEMENTO_HPP
+#define DELTA_MEMENTO_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "behavioral/memento.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace memento_delta {
+			// Delta memento. Snapshot stores only blocks of state, changed since previous snapshot.
+			// Memory of snapshot is O(changes) instead of O(state size).
+			// Every keyframe_interval snapshot is full keyframe, so restore applies at most
+			// keyframe_interval - 1 deltas.
+			//
+			// How to use:
+			// originator.CreateSnapshotIn(delta_care_taker);
+			// originator.RestoreFrom(delta_care_taker, n_recent);
+
+
+			/**
+			 * Customization point. Binary representation of state.
+			 * Bytes() - view of state as bytes. Assign() - restore state from bytes.
+			 * Is defined for trivially copyable states and std::vector of trivially copyable values.
+			 */
+			template<typename OriginatorStateT>
+			struct StateBytes;
+
+			template<typename OriginatorStateT>
+			requires std::is_trivially_copyable_v<OriginatorStateT>
+			struct StateBytes<OriginatorStateT> {
+				static inline std::span<const std::byte> Bytes(const OriginatorStateT& state_p) noexcept {
+					return std::as_bytes(std::span<const OriginatorStateT, 1>(&state_p, 1));
+				};
+				static inline void Assign(OriginatorStateT& state_p, const std::span<const std::byte> bytes_p) noexcept {
+					std::memcpy(&state_p, bytes_p.data(), std::min(bytes_p.size(), sizeof(OriginatorStateT)));
+				};
+			};
+
+			template<typename ValueT>
+			requires std::is_trivially_copyable_v<ValueT>
+			struct StateBytes<std::vector<ValueT>> {
+				static inline std::span<const std::byte> Bytes(const std::vector<ValueT>& state_p) noexcept {
+					return std::as_bytes(std::span<const ValueT>(state_p));
+				};
+				static inline void Assign(std::vector<ValueT>& state_p, const std::span<const std::byte> bytes_p) {
+					state_p.resize(bytes_p.size() / sizeof(ValueT));
+					if (!state_p.empty()) { std::memcpy(state_p.data(), bytes_p.data(), state_p.size() * sizeof(ValueT)); }
+				};
+			};
+
+			template<typename OriginatorStateT, typename StateBytesT = StateBytes<OriginatorStateT>>
+			concept BinaryState = std::is_default_constructible_v<OriginatorStateT> &&
+				requires(const OriginatorStateT& state, OriginatorStateT& mutable_state, std::span<const std::byte> bytes) {
+					{ StateBytesT::Bytes(state) } -> std::convertible_to<std::span<const std::byte>>;
+					StateBytesT::Assign(mutable_state, bytes);
+				};
+
+
+			/**
+			 * CareTaker, that stores history of snapshots as binary deltas.
+			 * State is split in blocks of block_size bytes. Snapshot stores only blocks, that differ
+			 * from previous snapshot. Comparison is made with shadow copy of previous snapshot, so
+			 * snapshot doesn't reconstruct anything.
+			 * Invariant: snapshots of one owner. Snapshot of another owner clears history.
+			 */
+			template<typename ConcreteOriginatorT, typename OriginatorStateT,
+					 typename StateBytesT = StateBytes<OriginatorStateT>>
+			requires BinaryState<OriginatorStateT, StateBytesT>
+			class DeltaCareTaker final {
+			public:
+				struct Options {
+					/** Granularity of diff. Smaller block - smaller delta, but more blocks to index. */
+					size_t block_size{ 256 };
+					/** Every N-th snapshot is full. Restore applies at most N - 1 deltas. */
+					size_t keyframe_interval{ 32 };
+					/** The oldest snapshots are evicted. */
+					size_t max_snapshots{ std::numeric_limits<size_t>::max() };
+				};
+
+				DeltaCareTaker() : DeltaCareTaker(Options{}) {};
+				explicit DeltaCareTaker(const Options& options_p)
+					: options_{ std::max<size_t>(options_p.block_size, 1),
+								std::max<size_t>(options_p.keyframe_interval, 1),
+								std::max<size_t>(options_p.max_snapshots, 1) } {
+				};
+
+				/**
+				 * Make snapshot of state. Is used by AbstractOriginator::CreateSnapshotIn.
+				 * Time is O(state size) comparison, memory is O(changed blocks).
+				 */
+				void Emplace(const ConcreteOriginatorT& owner_p, const OriginatorStateT& state_p) {
+					if (owner_ != &owner_p) {
+						Clear();
+						owner_ = &owner_p;
+					}
+					const std::span<const std::byte> bytes{ StateBytesT::Bytes(state_p) };
+
+					Snapshot snapshot{};
+					snapshot.state_size = bytes.size();
+					if (snapshots_.empty() || since_keyframe_ + 1 >= options_.keyframe_interval) {
+						snapshot.is_keyframe = true;
+						snapshot.data.assign(bytes.begin(), bytes.end());
+						previous_.assign(bytes.begin(), bytes.end());
+						since_keyframe_ = 0;
+					} else {
+						const size_t blocks_count{ (bytes.size() + options_.block_size - 1) / options_.block_size };
+						previous_.resize(bytes.size());
+						for (size_t block{}; block < blocks_count; ++block) {
+							const size_t begin{ block * options_.block_size };
+							const size_t length{ std::min(options_.block_size, bytes.size() - begin) };
+							if (begin + length > previous_size_ ||
+								std::memcmp(previous_.data() + begin, bytes.data() + begin, length) != 0) {
+								snapshot.blocks.push_back(static_cast<std::uint32_t>(block));
+								snapshot.data.insert(snapshot.data.end(), bytes.begin() + begin, bytes.begin() + begin + length);
+								std::memcpy(previous_.data() + begin, bytes.data() + begin, length);
+							}
+						}
+						++since_keyframe_;
+					}
+					previous_size_ = bytes.size();
+
+					bytes_ += SizeOf(snapshot);
+					snapshots_.push_back(std::move(snapshot));
+					while (snapshots_.size() > options_.max_snapshots) { PopOldest(); }
+				};
+
+				/**
+				 * Reconstruct state of n-th most recent snapshot. Is used by AbstractOriginator::RestoreFrom.
+				 * Applies at most keyframe_interval - 1 deltas.
+				 *
+				 * @return nullopt, if there is no such snapshot or caller is not owner
+				 */
+				std::optional<OriginatorStateT> Reconstruct(const ConcreteOriginatorT& caller_p, const size_t n_recent = 0,
+															const bool to_check_owner = true) const {
+					if (n_recent >= snapshots_.size() || (to_check_owner && &caller_p != owner_)) { return std::nullopt; }
+					const std::vector<std::byte> bytes{ ReconstructBytes(snapshots_.size() - 1 - n_recent) };
+					std::optional<OriginatorStateT> state{ std::in_place };
+					StateBytesT::Assign(*state, bytes);
+					return state;
+				};
+
+				/** Delete the newest snapshot, f.e. after undo. */
+				void PopNewest() {
+					if (snapshots_.empty()) { return; }
+					bytes_ -= SizeOf(snapshots_.back());
+					snapshots_.pop_back();
+					if (snapshots_.empty()) {
+						Clear();
+						return;
+					}
+					previous_ = ReconstructBytes(snapshots_.size() - 1);
+					previous_size_ = previous_.size();
+					since_keyframe_ = snapshots_.size() - 1 - FindKeyframe(snapshots_.size() - 1);
+				};
+
+				/** Delete the oldest snapshot. Next snapshot becomes keyframe. */
+				void PopOldest() {
+					if (snapshots_.size() <= 1) {
+						Clear();
+						return;
+					}
+					Snapshot& next{ snapshots_[1] };
+					if (!next.is_keyframe) {
+						bytes_ -= SizeOf(next);
+						next.data = ReconstructBytes(1);
+						next.blocks.clear();
+						next.is_keyframe = true;
+						bytes_ += SizeOf(next);
+					}
+					bytes_ -= SizeOf(snapshots_.front());
+					snapshots_.pop_front();
+				};
+
+				void Clear() noexcept {
+					snapshots_.clear();
+					previous_.clear();
+					previous_size_ = 0;
+					since_keyframe_ = 0;
+					bytes_ = 0;
+					owner_ = nullptr;
+				};
+
+				inline size_t size() const noexcept { return snapshots_.size(); };
+				inline bool empty() const noexcept { return snapshots_.empty(); };
+				/** Memory of all snapshots without shadow copy of previous state. */
+				inline size_t size_in_bytes() const noexcept { return bytes_; };
+				inline const Options& options() const noexcept { return options_; };
+
+			private:
+				struct Snapshot {
+					/** Full state for keyframe. Changed blocks one by one for delta. */
+					std::vector<std::byte> data{};
+					/** Indices of changed blocks. Empty for keyframe. */
+					std::vector<std::uint32_t> blocks{};
+					size_t state_size{};
+					bool is_keyframe{};
+				};
+
+				static inline size_t SizeOf(const Snapshot& snapshot_p) noexcept {
+					return snapshot_p.data.size() + snapshot_p.blocks.size() * sizeof(std::uint32_t);
+				};
+
+				inline size_t FindKeyframe(size_t index) const noexcept {
+					while (index > 0 && !snapshots_[index].is_keyframe) { --index; }
+					return index;
+				};
+
+				/** Keyframe + deltas up to snapshot with index. */
+				std::vector<std::byte> ReconstructBytes(const size_t index) const {
+					const size_t keyframe{ FindKeyframe(index) };
+					std::vector<std::byte> bytes{ snapshots_[keyframe].data };
+					for (size_t i{ keyframe + 1 }; i <= index; ++i) {
+						const Snapshot& delta{ snapshots_[i] };
+						bytes.resize(delta.state_size);
+						size_t data_offset{};
+						for (const std::uint32_t block : delta.blocks) {
+							const size_t begin{ block * options_.block_size };
+							const size_t length{ std::min(options_.block_size, delta.state_size - begin) };
+							std::memcpy(bytes.data() + begin, delta.data.data() + data_offset, length);
+							data_offset += length;
+						}
+					}
+					return bytes;
+				};
+
+// Data
+				Options options_;
+				std::deque<Snapshot> snapshots_{};
+
+				/** Shadow copy of the newest snapshot. Diff is made against it. */
+				std::vector<std::byte> previous_{};
+				size_t previous_size_{};
+				size_t since_keyframe_{};
+				size_t bytes_{};
+
+				/** Only owner can restore from snapshots */
+				const ConcreteOriginatorT* owner_{};
+
+			}; // !class DeltaCareTaker
+
+		} // !namespace memento_delta
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !DELTA_MEMENTO_HPP
@@ -0,0 +1,184 @@
+﻿#ifndef MEMENTO_POOL_HPP
+#define MEMENTO_POOL_HPP
+
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "behavioral/memento.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace memento_pool {
+			// Pooled mementos. Memento is a small trivially copyable handle {index, generation} to slot of pool.
+			// Slot holds state and id of owner. Slots are stored contiguously and are recycled: state of released slot
+			// is overwritten by assignment, so f.e. buffer of std::vector is reused without allocation.
+			// Owner check is kept: slot stores id of originator. Generation protects from use of recycled slot.
+			//
+			// How to use:
+			// MementoPool<ConcreteOriginatorT, OriginatorStateT>::Handle handle{ originator.CreateSnapshotIn(pool) };
+			// originator.RestoreFrom(pool, handle);
+			// pool.Release(handle);
+
+
+			using OriginatorID = std::uint64_t;
+
+			/**
+			 * Unique id of originator object. Is never reused in process, unlike address of object.
+			 * Is used as data member or base of Concrete Originator. Copy of originator gets new id.
+			 */
+			class OriginatorIdentity {
+			public:
+				OriginatorIdentity() noexcept : originator_id_{ NextID() } {};
+				OriginatorIdentity(const OriginatorIdentity&) noexcept : originator_id_{ NextID() } {};
+				OriginatorIdentity& operator=(const OriginatorIdentity&) noexcept { return *this; };	// id is not changed
+				~OriginatorIdentity() = default;
+
+				inline OriginatorID originator_id() const noexcept { return originator_id_; };
+
+			private:
+				static inline OriginatorID NextID() noexcept {
+					static std::atomic<OriginatorID> counter{};
+					return counter.fetch_add(1, std::memory_order_relaxed) + 1;	// 0 is no owner
+				};
+
+				const OriginatorID originator_id_;
+			};
+
+			template<typename ConcreteOriginatorT>
+			concept WithOriginatorID = requires(const ConcreteOriginatorT& originator) {
+				{ originator.originator_id() } -> std::convertible_to<OriginatorID>;
+			};
+
+
+			/**
+			 * Pool of snapshots of originators of one type.
+			 * Emplace and Release are O(1). Released slots are reused by next Emplace.
+			 * Id of owner is originator_id(), if Concrete Originator has it (f.e. OriginatorIdentity),
+			 * otherwise address of originator.
+			 *
+			 * Not thread safe.
+			 */
+			template<typename ConcreteOriginatorT, typename OriginatorStateT>
+			class MementoPool final {
+			public:
+				/** Memento. Trivially copyable, can be stored in any container and passed by value. */
+				struct Handle {
+					std::uint32_t index{ std::numeric_limits<std::uint32_t>::max() };
+					std::uint32_t generation{};
+
+					friend inline bool operator==(const Handle&, const Handle&) noexcept = default;
+				};
+				static_assert(std::is_trivially_copyable_v<Handle>);
+
+				MementoPool() = default;
+				explicit MementoPool(const size_t reserve_p) { slots_.reserve(reserve_p); };
+
+				/**
+				 * Copy state to free slot. Is used by AbstractOriginator::CreateSnapshotIn.
+				 * Allocates only, when there is no free slot.
+				 */
+				Handle Emplace(const ConcreteOriginatorT& owner_p, const OriginatorStateT& state_p) {
+					std::uint32_t index{};
+					if (free_head_ != kNull) {
+						index = free_head_;
+						Slot& slot{ slots_[index] };
+						slot.state = state_p;	// reuse resources of old state. If copy throws, free list is intact
+						free_head_ = slot.next_free;
+					} else {
+						slots_.push_back(Slot{ state_p });
+						index = static_cast<std::uint32_t>(slots_.size() - 1);
+					}
+					Slot& slot{ slots_[index] };
+					slot.owner_id = IDOf(owner_p);
+					slot.next_free = kNull;
+					slot.is_used = true;
+					++size_;
+					return Handle{ index, slot.generation };
+				};
+
+				/**
+				 * State of snapshot. Is used by AbstractOriginator::RestoreFrom.
+				 * @return nullptr, if handle is released or caller is not owner
+				 */
+				const OriginatorStateT* Reconstruct(const ConcreteOriginatorT& caller_p, const Handle handle_p,
+													const bool to_check_owner = true) const noexcept {
+					if (!IsValid(handle_p)) { return nullptr; }
+					const Slot& slot{ slots_[handle_p.index] };
+					if (to_check_owner && slot.owner_id != IDOf(caller_p)) { return nullptr; }
+					return &slot.state;
+				};
+
+				/**
+				 * Return slot to pool. State is kept for reuse. Handle and its copies become invalid.
+				 * @return false, if handle is already released
+				 */
+				bool Release(const Handle handle_p) noexcept {
+					if (!IsValid(handle_p)) { return false; }
+					Slot& slot{ slots_[handle_p.index] };
+					slot.owner_id = 0;
+					slot.is_used = false;
+					++slot.generation;
+					slot.next_free = free_head_;
+					free_head_ = handle_p.index;
+					--size_;
+					return true;
+				};
+
+				inline bool IsValid(const Handle handle_p) const noexcept {
+					return handle_p.index < slots_.size() && slots_[handle_p.index].is_used
+						&& slots_[handle_p.index].generation == handle_p.generation;
+				};
+
+				/** Release all snapshots. Slots are kept for reuse. All handles become invalid. */
+				void Clear() noexcept {
+					for (std::uint32_t index{}; index < slots_.size(); ++index) {
+						Release(Handle{ index, slots_[index].generation });
+					}
+				};
+
+				/** Count of snapshots in use. */
+				inline size_t size() const noexcept { return size_; };
+				/** Count of slots in use and free. */
+				inline size_t capacity() const noexcept { return slots_.size(); };
+
+			private:
+				static constexpr std::uint32_t kNull{ std::numeric_limits<std::uint32_t>::max() };
+
+				struct Slot {
+					OriginatorStateT state;
+					OriginatorID owner_id{};
+					std::uint32_t generation{};	// is incremented on release, so old handles are invalid
+					std::uint32_t next_free{ kNull };
+					bool is_used{};
+				};
+
+				static inline OriginatorID IDOf(const ConcreteOriginatorT& originator_p) noexcept {
+					if constexpr (WithOriginatorID<ConcreteOriginatorT>) {
+						return static_cast<OriginatorID>(originator_p.originator_id());
+					} else {
+						return static_cast<OriginatorID>(reinterpret_cast<std::uintptr_t>(std::addressof(originator_p)));
+					}
+				};
+
+// Data
+				std::vector<Slot> slots_{};
+				std::uint32_t free_head_{ kNull };
+				size_t size_{};
+
+			}; // !class MementoPool
+
+		} // !namespace memento_pool
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !MEMENTO_POOL_HPP
@@ -0,0 +1,454 @@
+﻿#ifndef SERIALIZED_MEMENTO_HPP
+#define SERIALIZED_MEMENTO_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "behavioral/memento.hpp"
+#include "support/binary-io.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace behavioral {
+
+		namespace memento_serialization {
+			// Binary serialization of memento state and spill of old snapshots to memory-mapped file.
+			// Newest snapshots are kept in RAM as objects. Older snapshots are serialized, optionally compressed
+			// and appended to spill file. On restore they are read back from mapping: OS loads only touched pages.
+			// Memory is bounded by memory_snapshots, history depth is bounded only by disk.
+			//
+			// Serialization:
+			//	trivially copyable state	- memcpy.
+			//	other state					- static VisitFields(self, visitor), that calls visitor(field_1, field_2, ...).
+			//								  Fields: trivially copyable, std::string, std::vector, visitable structs.
+
+			using support::MappedFile;
+			using support::ReadValue;
+			using support::WriteValue;
+
+
+			/**
+			 * State with field visitor. Same function is used for writing (const self) and for reading.
+			 * template<typename SelfT, typename VisitorT>
+			 * static void VisitFields(SelfT& self, VisitorT&& visitor) { visitor(self.a, self.name); };
+			 */
+			template<typename StateT>
+			concept VisitableState = requires(StateT& state, const StateT& const_state) {
+				StateT::VisitFields(state, [](auto&...) {});
+				StateT::VisitFields(const_state, [](const auto&...) {});
+			};
+
+			template<typename T>
+			struct IsVector : std::false_type {};
+			template<typename T, typename AllocatorT>
+			struct IsVector<std::vector<T, AllocatorT>> : std::true_type {};
+
+
+			/** Writes fields to buffer. */
+			class BinaryWriter final {
+			public:
+				explicit BinaryWriter(std::vector<std::byte>& buffer_p) noexcept : buffer_{ buffer_p } {};
+
+				template<typename... FieldsT>
+				inline void operator()(const FieldsT&... fields_p) { (Write(fields_p), ...); };
+
+				template<typename FieldT>
+				void Write(const FieldT& field_p) {
+					if constexpr (std::is_trivially_copyable_v<FieldT>) {
+						WriteValue(buffer_, field_p);
+					} else if constexpr (std::is_same_v<FieldT, std::string>) {
+						WriteValue(buffer_, static_cast<std::uint64_t>(field_p.size()));
+						const auto* bytes{ reinterpret_cast<const std::byte*>(field_p.data()) };
+						buffer_.insert(buffer_.end(), bytes, bytes + field_p.size());
+					} else if constexpr (IsVector<FieldT>::value) {
+						WriteValue(buffer_, static_cast<std::uint64_t>(field_p.size()));
+						if constexpr (std::is_trivially_copyable_v<typename FieldT::value_type>) {	// fast path
+							const auto bytes{ std::as_bytes(std::span(field_p)) };
+							buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+						} else {
+							for (const auto& value : field_p) { Write(value); }
+						}
+					} else {
+						static_assert(VisitableState<FieldT>, "Field must be trivially copyable, string, vector or visitable");
+						FieldT::VisitFields(field_p, *this);
+					}
+				};
+
+			private:
+				std::vector<std::byte>& buffer_;
+			};
+
+
+			/** Reads fields from bytes. Throws std::out_of_range, if bytes are too short. */
+			class BinaryReader final {
+			public:
+				explicit BinaryReader(const std::span<const std::byte> bytes_p) noexcept : bytes_{ bytes_p } {};
+
+				template<typename... FieldsT>
+				inline void operator()(FieldsT&... fields_p) { (Read(fields_p), ...); };
+
+				template<typename FieldT>
+				void Read(FieldT& field_p) {
+					if constexpr (std::is_trivially_copyable_v<FieldT>) {
+						field_p = ReadValue<FieldT>(bytes_, offset_);
+					} else if constexpr (std::is_same_v<FieldT, std::string>) {
+						const size_t size{ ReadSize(1) };
+						field_p.assign(reinterpret_cast<const char*>(bytes_.data() + offset_), size);
+						offset_ += size;
+					} else if constexpr (IsVector<FieldT>::value) {
+						using ValueT = typename FieldT::value_type;
+						if constexpr (std::is_trivially_copyable_v<ValueT>) {	// fast path
+							const size_t size{ ReadSize(sizeof(ValueT)) };
+							field_p.resize(size);
+							if (size > 0) { std::memcpy(field_p.data(), bytes_.data() + offset_, size * sizeof(ValueT)); }
+							offset_ += size * sizeof(ValueT);
+						} else {
+							const size_t size{ ReadSize(1) };
+							field_p.resize(size);
+							for (ValueT& value : field_p) { Read(value); }
+						}
+					} else {
+						static_assert(VisitableState<FieldT>, "Field must be trivially copyable, string, vector or visitable");
+						FieldT::VisitFields(field_p, *this);
+					}
+				};
+
+				inline size_t offset() const noexcept { return offset_; };
+
+			private:
+				/** Read count of elements and check, that elements fit in bytes. */
+				size_t ReadSize(const size_t element_size_p) {
+					const auto size{ ReadValue<std::uint64_t>(bytes_, offset_) };
+					if (size > (bytes_.size() - offset_) / element_size_p) {
+						throw std::out_of_range("BinaryReader: record is too short");
+					}
+					return static_cast<size_t>(size);
+				};
+
+				std::span<const std::byte> bytes_;
+				size_t offset_{};
+			};
+
+
+			/** Serialize state to the end of buffer. */
+			template<typename StateT>
+			inline void Serialize(const StateT& state_p, std::vector<std::byte>& buffer_p) {
+				BinaryWriter{ buffer_p }.Write(state_p);
+			};
+
+			/** Deserialize state from bytes. Resources of state_p are reused. */
+			template<typename StateT>
+			inline void Deserialize(StateT& state_p, const std::span<const std::byte> bytes_p) {
+				BinaryReader{ bytes_p }.Read(state_p);
+			};
+
+
+			/**
+			 * Fast LZ77 compression with byte-aligned sequences. No entropy coding: speed is more important than ratio.
+			 * Format is own: it is read only by Decompress.
+			 * Sequence: [token: literals count 4 bits | match length - 4 4 bits][extra literals count]
+			 *			 [literals][offset uint16][extra match length]. Last sequence has only literals.
+			 * Counts >= 15 are continued by bytes of 255 and a byte < 255.
+			 */
+			class FastCompression final {
+			public:
+				/** Append compressed bytes to out_p. */
+				static void Compress(const std::span<const std::byte> input_p, std::vector<std::byte>& out_p) {
+					std::array<std::uint32_t, kHashSize> table{};	// position + 1, 0 - empty
+					const size_t size{ input_p.size() };
+					const std::byte* const input{ input_p.data() };
+					size_t anchor{};
+					size_t position{};
+					while (size >= kMinMatch + kLastLiterals && position + kMinMatch + kLastLiterals <= size) {
+						const std::uint32_t sequence{ Load32(input + position) };
+						std::uint32_t& entry{ table[Hash(sequence)] };
+						const size_t candidate{ entry };
+						entry = static_cast<std::uint32_t>(position + 1);
+						if (candidate == 0 || position + 1 - candidate > kMaxOffset || Load32(input + candidate - 1) != sequence) {
+							++position;
+							continue;
+						}
+						const size_t match{ candidate - 1 };
+						size_t length{ kMinMatch };
+						const size_t max_length{ size - kLastLiterals - position };
+						while (length < max_length && input[match + length] == input[position + length]) { ++length; }
+
+						WriteSequence(out_p, input_p.subspan(anchor, position - anchor), position - match, length);
+						position += length;
+						anchor = position;
+					}
+					WriteLiterals(out_p, input_p.subspan(anchor), 0);
+				};
+
+				/**
+				 * @param raw_size_p size of original data
+				 * @throws std::runtime_error, if compressed data is corrupted
+				 */
+				static void Decompress(const std::span<const std::byte> input_p, const size_t raw_size_p,
+									   std::vector<std::byte>& out_p) {
+					out_p.resize(raw_size_p);
+					size_t in{};
+					size_t out{};
+					while (in < input_p.size()) {
+						const auto token{ static_cast<std::uint8_t>(input_p[in++]) };
+						const size_t literals{ ReadLength(input_p, in, token >> 4) };
+						if (literals > input_p.size() - in || literals > raw_size_p - out) { ThrowCorrupted(); }
+						if (literals > 0) { std::memcpy(out_p.data() + out, input_p.data() + in, literals); }
+						in += literals;
+						out += literals;
+						if (in == input_p.size()) { break; }	// last sequence
+
+						if (input_p.size() - in < 2) { ThrowCorrupted(); }
+						const size_t offset{ static_cast<size_t>(input_p[in]) | (static_cast<size_t>(input_p[in + 1]) << 8) };
+						in += 2;
+						const size_t length{ ReadLength(input_p, in, token & 0x0F) + kMinMatch };
+						if (offset == 0 || offset > out || length > raw_size_p - out) { ThrowCorrupted(); }
+						for (size_t i{}; i < length; ++i, ++out) { out_p[out] = out_p[out - offset]; }	// may overlap
+					}
+					if (out != raw_size_p) { ThrowCorrupted(); }
+				};
+
+			private:
+				static constexpr size_t kMinMatch{ 4 };
+				static constexpr size_t kLastLiterals{ 5 };
+				static constexpr size_t kMaxOffset{ 65535 };
+				static constexpr size_t kHashBits{ 12 };
+				static constexpr size_t kHashSize{ size_t{ 1 } << kHashBits };
+
+				static inline std::uint32_t Load32(const std::byte* data_p) noexcept {
+					std::uint32_t value{};
+					std::memcpy(&value, data_p, sizeof(value));
+					return value;
+				};
+
+				static inline size_t Hash(const std::uint32_t sequence_p) noexcept {
+					return (sequence_p * 2654435761u) >> (32 - kHashBits);
+				};
+
+				static void WriteLength(std::vector<std::byte>& out_p, size_t length_p) {
+					for (; length_p >= 255; length_p -= 255) { out_p.push_back(std::byte{ 255 }); }
+					out_p.push_back(static_cast<std::byte>(length_p));
+				};
+
+				static size_t ReadLength(const std::span<const std::byte> input_p, size_t& in_p, const size_t nibble_p) {
+					size_t length{ nibble_p };
+					if (nibble_p != 15) { return length; }
+					while (true) {
+						if (in_p >= input_p.size()) { ThrowCorrupted(); }
+						const auto extra{ static_cast<size_t>(input_p[in_p++]) };
+						length += extra;
+						if (extra != 255) { return length; }
+					}
+				};
+
+				static void WriteLiterals(std::vector<std::byte>& out_p, const std::span<const std::byte> literals_p,
+										  const size_t match_nibble_p) {
+					out_p.push_back(static_cast<std::byte>((std::min<size_t>(literals_p.size(), 15) << 4) | match_nibble_p));
+					if (literals_p.size() >= 15) { WriteLength(out_p, literals_p.size() - 15); }
+					out_p.insert(out_p.end(), literals_p.begin(), literals_p.end());
+				};
+
+				static void WriteSequence(std::vector<std::byte>& out_p, const std::span<const std::byte> literals_p,
+										  const size_t offset_p, const size_t length_p) {
+					const size_t match_length{ length_p - kMinMatch };
+					WriteLiterals(out_p, literals_p, std::min<size_t>(match_length, 15));
+					out_p.push_back(static_cast<std::byte>(offset_p & 0xFF));
+					out_p.push_back(static_cast<std::byte>(offset_p >> 8));
+					if (match_length >= 15) { WriteLength(out_p, match_length - 15); }
+				};
+
+				[[noreturn]] static void ThrowCorrupted() {
+					throw std::runtime_error("FastCompression: compressed data is corrupted");
+				};
+			}; // !class FastCompression
+
+
+			enum class Compression : std::uint8_t {
+				kNone,
+				kFast
+			};
+
+			struct SpillOptions {
+				/** Count of the newest snapshots, that are kept in RAM as objects. */
+				size_t memory_snapshots{ 16 };
+				/** File for older snapshots. Is removed with CareTaker. Empty - unique file in temp directory. */
+				std::filesystem::path spill_path{};
+				Compression compression{ Compression::kFast };
+				/** Spill file grows by this step. */
+				size_t grow_step{ 1 << 20 };
+			};
+
+
+			/**
+			 * CareTaker with unbounded history: the newest snapshots are in RAM, older are spilled to memory-mapped file.
+			 * Restore of spilled snapshot deserializes it from mapping. Restore of the newest is a copy.
+			 * Invariant: snapshots of one owner. Snapshot of another owner clears history.
+			 *
+			 * Not thread safe.
+			 */
+			template<typename ConcreteOriginatorT, typename OriginatorStateT>
+			requires std::is_default_constructible_v<OriginatorStateT>
+			class SpillingCareTaker final {
+			public:
+				explicit SpillingCareTaker(SpillOptions options_p = {}) : options_{ std::move(options_p) } {
+					options_.memory_snapshots = std::max<size_t>(options_.memory_snapshots, 1);
+					options_.grow_step = std::max<size_t>(options_.grow_step, 4096);
+					if (options_.spill_path.empty()) {
+						std::random_device random{};
+						options_.spill_path = std::filesystem::temp_directory_path() /
+							("memento-spill-" + std::to_string(random()) + "-" + std::to_string(random()) + ".bin");
+					}
+				};
+
+				SpillingCareTaker(const SpillingCareTaker&) = delete;
+				SpillingCareTaker& operator=(const SpillingCareTaker&) = delete;
+				SpillingCareTaker(SpillingCareTaker&&) noexcept = delete;
+				SpillingCareTaker& operator=(SpillingCareTaker&&) noexcept = delete;
+
+				~SpillingCareTaker() {
+					if (file_.is_open()) {
+						file_.Close();
+						std::error_code error{};
+						std::filesystem::remove(options_.spill_path, error);
+					}
+				};
+
+				/** Make snapshot. Is used by AbstractOriginator::CreateSnapshotIn. */
+				void Emplace(const ConcreteOriginatorT& owner_p, const OriginatorStateT& state_p) {
+					if (owner_ != &owner_p) {
+						Clear();
+						owner_ = &owner_p;
+					}
+					memory_.push_back(state_p);
+					if (memory_.size() > options_.memory_snapshots) {
+						Spill(memory_.front());
+						memory_.pop_front();
+					}
+				};
+
+				/**
+				 * Reconstruct n-th most recent snapshot. Is used by AbstractOriginator::RestoreFrom.
+				 * @return nullopt, if there is no such snapshot or caller is not owner
+				 */
+				std::optional<OriginatorStateT> Reconstruct(const ConcreteOriginatorT& caller_p, const size_t n_recent = 0,
+															const bool to_check_owner = true) const {
+					if (n_recent >= size() || (to_check_owner && &caller_p != owner_)) { return std::nullopt; }
+					if (n_recent < memory_.size()) { return memory_[memory_.size() - 1 - n_recent]; }
+					std::optional<OriginatorStateT> state{ std::in_place };
+					Load(spilled_[spilled_.size() - 1 - (n_recent - memory_.size())], *state);
+					return state;
+				};
+
+				/** Delete the newest snapshot. Space of the newest spilled snapshot is reused. */
+				void PopNewest() {
+					if (!memory_.empty()) {
+						memory_.pop_back();
+					}
+					if (memory_.empty() && !spilled_.empty()) {
+						memory_.emplace_back();
+						Load(spilled_.back(), memory_.back());
+						write_offset_ = spilled_.back().offset;
+						spilled_.pop_back();
+					}
+				};
+
+				/** Delete all snapshots. Spill file is kept for reuse. */
+				void Clear() noexcept {
+					memory_.clear();
+					spilled_.clear();
+					write_offset_ = 0;
+					owner_ = nullptr;
+				};
+
+				inline size_t size() const noexcept { return memory_.size() + spilled_.size(); };
+				inline size_t memory_snapshots() const noexcept { return memory_.size(); };
+				inline size_t spilled_snapshots() const noexcept { return spilled_.size(); };
+				/** Bytes of spilled snapshots in file. */
+				inline size_t spilled_bytes() const noexcept { return write_offset_; };
+				inline const SpillOptions& options() const noexcept { return options_; };
+
+			private:
+				struct SpilledRecord {
+					size_t offset{};
+					size_t stored_size{};
+					size_t raw_size{};
+					Compression compression{};
+				};
+
+				void Spill(const OriginatorStateT& state_p) {
+					buffer_.clear();
+					Serialize(state_p, buffer_);
+					std::span<const std::byte> stored{ buffer_ };
+					SpilledRecord record{ write_offset_, buffer_.size(), buffer_.size(), Compression::kNone };
+					if (options_.compression == Compression::kFast) {
+						compressed_.clear();
+						FastCompression::Compress(buffer_, compressed_);
+						if (compressed_.size() < buffer_.size()) {	// incompressible data is stored raw
+							stored = compressed_;
+							record.stored_size = compressed_.size();
+							record.compression = Compression::kFast;
+						}
+					}
+
+					if (write_offset_ + stored.size() > file_.size()) {
+						const size_t required{ write_offset_ + stored.size() };
+						file_ = MappedFile(options_.spill_path, (required / options_.grow_step + 1) * options_.grow_step);
+					}
+					if (!stored.empty()) { std::memcpy(file_.data() + write_offset_, stored.data(), stored.size()); }
+					write_offset_ += stored.size();
+					spilled_.push_back(record);
+				};
+
+				void Load(const SpilledRecord& record_p, OriginatorStateT& state_p) const {
+					const std::span<const std::byte> stored{ file_.data() + record_p.offset, record_p.stored_size };
+					if (record_p.compression == Compression::kFast) {
+						FastCompression::Decompress(stored, record_p.raw_size, decompressed_);
+						Deserialize(state_p, decompressed_);
+					} else {
+						Deserialize(state_p, stored);
+					}
+				};
+
+// Data
+				SpillOptions options_;
+				std::deque<OriginatorStateT> memory_{};
+				std::vector<SpilledRecord> spilled_{};	// the oldest first
+
+				MappedFile file_{};
+				size_t write_offset_{};
+
+				std::vector<std::byte> buffer_{};
+				std::vector<std::byte> compressed_{};
+				mutable std::vector<std::byte> decompressed_{};
+
+				/** Only owner can restore from snapshots */
+				const ConcreteOriginatorT* owner_{};
+
+				/*
+				* Class Design:
+				* Spill file is a private scratch file, not a durable log, so it is never synced:
+				* OS writes dirty pages back only under memory pressure.
+				*/
+
+			}; // !class SpillingCareTaker
+
+		} // !namespace memento_serialization
+
+	} // !namespace behavioral
+} // !namespace pattern
+
+#endif // !SERIALIZED_MEMENTO_HPP
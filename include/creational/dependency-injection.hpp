@@ -1,8 +1,22 @@
 ﻿#ifndef DEPENDENCY_INJECTION_HPP
 #define DEPENDENCY_INJECTION_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 /** Software Design Patterns */
 namespace pattern {
@@ -93,6 +107,561 @@ namespace pattern {
 		} // !namespace dependency_injection
 
 
+		namespace dependency_injection_static {
+			// Compile-time dependency injection container. Composition root declares bindings as types,
+			// injector resolves graph of dependencies during compilation, checks it and constructs all components
+			// inline, in topological order, without heap. Components get dependencies by reference
+			// to concrete type, so there is no virtual call and optimizer can inline calls between components.
+			//
+			// How to use:
+			// class Repository {
+			// public:
+			//     using Dependencies = Inject<LoggerTag>;
+			//     explicit Repository(ConsoleLogger& logger_p);
+			// };
+			// Injector<Bind<LoggerTag, ConsoleLogger>, Bind<Repository>> injector{};
+			// injector.Get<Repository>().Save();
+
+
+			/** List of dependencies of component: interfaces or tags, that are bound in injector. */
+			template<typename... DependenciesT>
+			struct Inject {};
+
+			/**
+			 * Binding of interface to implementation. Interface is a tag or a base class, it is not used for calls.
+			 * Bind<T> binds component to itself.
+			 */
+			template<typename InterfaceT, typename ImplementationT = InterfaceT>
+			struct Bind {
+				using Interface = InterfaceT;
+				using Implementation = ImplementationT;
+			};
+
+			/** Dependencies of component. Component without Dependencies is default constructed. */
+			template<typename ComponentT>
+			struct DependenciesOf {
+				using type = Inject<>;
+			};
+
+			template<typename ComponentT> requires requires { typename ComponentT::Dependencies; }
+			struct DependenciesOf<ComponentT> {
+				using type = typename ComponentT::Dependencies;
+			};
+
+
+			/**
+			 * Container of components. Every binding is one component, that is owned by injector.
+			 * Constructor creates components in topological order of dependencies, destructor destroys them in reverse order.
+			 * Unbound dependency and cycle of dependencies are compile errors.
+			 * Get is a constant offset from injector: no lookup, no virtual call, no allocation.
+			 */
+			template<typename... BindingsT>
+			class Injector final {
+			public:
+				static constexpr size_t kCount{ sizeof...(BindingsT) };
+
+				/** Index of binding of interface, or of implementation, if interface is not bound. kCount if it is not bound. */
+				template<typename InterfaceT>
+				static constexpr size_t IndexOf() noexcept {
+					constexpr std::array<bool, kCount> is_interface{ std::is_same_v<InterfaceT, typename BindingsT::Interface>... };
+					constexpr std::array<bool, kCount> is_implementation{ std::is_same_v<InterfaceT, typename BindingsT::Implementation>... };
+					for (size_t index{}; index < kCount; ++index) { if (is_interface[index]) { return index; } }
+					for (size_t index{}; index < kCount; ++index) { if (is_implementation[index]) { return index; } }
+					return kCount;
+				};
+
+				/** Concrete type, that is bound to interface. */
+				template<typename InterfaceT>
+				using Resolve = std::tuple_element_t<IndexOf<InterfaceT>(), std::tuple<typename BindingsT::Implementation...>>;
+
+				Injector() { ConstructAll(std::make_index_sequence<kCount>{}); };
+
+				Injector(const Injector&) = delete;	// components hold references to each other
+				Injector& operator=(const Injector&) = delete;
+				Injector(Injector&&) noexcept = delete;
+				Injector& operator=(Injector&&) noexcept = delete;
+
+				~Injector() { DestroyFirst(constructed_); };
+
+				/** Component, that is bound to interface. */
+				template<typename InterfaceT>
+				inline Resolve<InterfaceT>& Get() noexcept {
+					constexpr size_t kIndex{ IndexOf<InterfaceT>() };
+					static_assert(kIndex < kCount, "Interface is not bound in Injector");
+					return *std::launder(reinterpret_cast<Resolve<InterfaceT>*>(std::get<kIndex>(slots_).bytes));
+				};
+
+				/** New object, that is not owned by injector, with dependencies from injector. F.e. request handler. */
+				template<typename ObjectT>
+				ObjectT Create() { return CreateWith<ObjectT>(typename DependenciesOf<ObjectT>::type{}); };
+
+				/** Order of construction: indexes of bindings. */
+				static constexpr std::array<size_t, kCount> construction_order() noexcept { return kPlan.order; };
+
+			private:
+				template<typename ComponentT>
+				struct Slot {
+					alignas(ComponentT) std::byte bytes[sizeof(ComponentT)];
+				};
+
+				struct Plan {
+					std::array<size_t, kCount> order{};
+					bool is_bound{ true };
+					bool is_acyclic{ true };
+				};
+
+				template<typename... DependenciesT>
+				static constexpr std::array<size_t, sizeof...(DependenciesT)> IndexesOf(Inject<DependenciesT...>) noexcept {
+					return { IndexOf<DependenciesT>()... };
+				};
+
+				/** Kahn's algorithm in order of bindings. */
+				static constexpr Plan MakePlan() noexcept {
+					Plan plan{};
+					std::array<std::array<bool, kCount>, kCount> depends{};	// [i][j] - i depends on j
+					size_t binding{};
+					([&]() {
+						for (const size_t dependency : IndexesOf(typename DependenciesOf<typename BindingsT::Implementation>::type{})) {
+							if (dependency == kCount) { plan.is_bound = false; } else { depends[binding][dependency] = true; }
+						}
+						++binding;
+					}(), ...);
+
+					std::array<bool, kCount> is_placed{};
+					for (size_t position{}; position < kCount; ++position) {
+						size_t next{ kCount };
+						for (size_t candidate{}; candidate < kCount && next == kCount; ++candidate) {
+							if (is_placed[candidate]) { continue; }
+							bool is_ready{ true };
+							for (size_t dependency{}; dependency < kCount; ++dependency) {
+								if (depends[candidate][dependency] && !is_placed[dependency]) { is_ready = false; }
+							}
+							if (is_ready) { next = candidate; }
+						}
+						if (next == kCount) {
+							plan.is_acyclic = false;
+							return plan;
+						}
+						is_placed[next] = true;
+						plan.order[position] = next;
+					}
+					return plan;
+				};
+
+				static constexpr Plan kPlan{ MakePlan() };
+				static_assert(kPlan.is_bound, "Dependency of component is not bound in Injector");
+				static_assert(kPlan.is_acyclic, "Dependencies of components have cycle");
+
+				template<typename ObjectT, typename... DependenciesT>
+				inline ObjectT CreateWith(Inject<DependenciesT...>) { return ObjectT(Get<DependenciesT>()...); };
+
+				template<size_t kIndex>
+				void Construct() {
+					using ComponentT = std::tuple_element_t<kIndex, std::tuple<typename BindingsT::Implementation...>>;
+					::new (static_cast<void*>(std::get<kIndex>(slots_).bytes)) ComponentT(
+						CreateWith<ComponentT>(typename DependenciesOf<ComponentT>::type{}));
+				};
+
+				template<size_t... kPositions>
+				void ConstructAll(std::index_sequence<kPositions...>) {
+					try {
+						((Construct<kPlan.order[kPositions]>(), ++constructed_), ...);	// left to right
+					} catch (...) {
+						DestroyFirst(constructed_);
+						throw;
+					}
+				};
+
+				/** Destroy first count_p components of construction order in reverse order. */
+				void DestroyFirst(const size_t count_p) noexcept {
+					DestroyReverse(count_p, std::make_index_sequence<kCount>{});
+					constructed_ = 0;
+				};
+
+				template<size_t... kPositions>
+				void DestroyReverse(const size_t count_p, std::index_sequence<kPositions...>) noexcept {
+					// position kCount - 1 - i is destroyed on step i
+					((kCount - 1 - kPositions < count_p ? Destroy<kPlan.order[kCount - 1 - kPositions]>() : void()), ...);
+				};
+
+				template<size_t kIndex>
+				void Destroy() noexcept {
+					using ComponentT = std::tuple_element_t<kIndex, std::tuple<typename BindingsT::Implementation...>>;
+					std::destroy_at(std::launder(reinterpret_cast<ComponentT*>(std::get<kIndex>(slots_).bytes)));
+				};
+
+// Data
+				std::tuple<Slot<typename BindingsT::Implementation>...> slots_{};
+				size_t constructed_{};
+
+			}; // !class Injector
+
+		} // !namespace dependency_injection_static
+
+
+		namespace dependency_injection_runtime {
+			// Runtime dependency injection container for plugin style wiring.
+			// Every type gets dense index (TypeSlot) on the first use, so registration is found by indexing of vector,
+			// without std::map<std::type_index>. Registration is closed by Freeze: singletons are constructed,
+			// then container is immutable and Resolve is lock-free.
+			// Instances are constructed in arena of scope and are destroyed in reverse order with scope.
+			//
+			// How to use:
+			// Container container{};
+			// container.Register<ILogger, ConsoleLogger>(Lifetime::kSingleton);
+			// container.Register<RequestContext>(Lifetime::kScoped);
+			// container.Freeze();
+			// Scope scope{ container };	// per request
+			// scope.Resolve<RequestContext>();
+
+			using ::pattern::creational::dependency_injection_static::Inject;
+			using ::pattern::creational::dependency_injection_static::DependenciesOf;
+
+			enum class Lifetime : std::uint8_t {
+				kSingleton,		// one per container, is constructed by Freeze
+				kTransient,		// new one per Resolve, is owned by scope
+				kThreadLocal,	// one per thread and container
+				kScoped,		// one per Scope, f.e. per request
+			};
+
+			inline size_t NextTypeSlot() noexcept {
+				static std::atomic<size_t> counter{};
+				return counter.fetch_add(1, std::memory_order_relaxed);
+			};
+
+			/** Dense index of type. Is the same for all containers. */
+			template<typename T>
+			inline size_t TypeSlot() noexcept {
+				static const size_t slot{ NextTypeSlot() };
+				return slot;
+			};
+
+			class Scope;
+			class Container;
+			struct ThreadScopes;
+
+			struct Registration {
+				Lifetime lifetime{};
+				size_t size{};
+				size_t alignment{};
+				std::function<void*(void* memory, Scope& scope)> construct{};	// returns pointer to interface
+				void (*destroy)(void* memory) noexcept {};
+				void* singleton{};	// interface of constructed singleton
+				bool is_registered{};
+				bool is_constructing{};	// detection of cycles
+				std::vector<size_t> dependencies{};	// slots of Dependencies. Dependencies of factory are not known
+			};
+
+			struct Registry {
+				std::uint64_t id{};
+				std::vector<Registration> registrations{};	// index is TypeSlot of interface
+				std::vector<size_t> order{};	// slots in order of registration
+				bool is_freezing{};
+				bool is_frozen{};
+				std::shared_ptr<ThreadScopes> thread_scopes{};	// is created by Container
+			};
+
+
+			/**
+			 * Resolver and owner of instances. Instances are constructed in arena of scope
+			 * and are destroyed in reverse order of construction by destructor of scope.
+			 * Scope resolves all lifetimes: singleton from container, thread local from thread scope,
+			 * scoped and transient are owned by this scope.
+			 *
+			 * Not thread safe: one scope is used by one thread, f.e. request handler.
+			 */
+			class Scope final {
+			public:
+				/** Scope of request. Container must be frozen. */
+				explicit Scope(Container& container_p);
+
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+				Scope(Scope&&) noexcept = delete;
+				Scope& operator=(Scope&&) noexcept = delete;
+
+				~Scope() {
+					for (auto destructor{ destructors_.rbegin() }; destructor != destructors_.rend(); ++destructor) {
+						destructor->destroy(destructor->memory);
+					}
+				};
+
+				/** Instance of interface. Throws std::logic_error, if it is not registered or lifetime is not allowed. */
+				template<typename InterfaceT>
+				inline InterfaceT& Resolve() { return *static_cast<InterfaceT*>(ResolveSlot(TypeSlot<InterfaceT>())); };
+
+			private:
+				friend class Container;
+
+				enum class Kind : std::uint8_t {
+					kRoot,		// singletons, is used only by Freeze
+					kThread,	// thread local instances
+					kRequest,	// scoped instances
+				};
+
+				struct Destructor {
+					void (*destroy)(void* memory) noexcept;
+					void* memory;
+				};
+
+				Scope(Registry& registry_p, const Kind kind_p) : registry_{ registry_p }, kind_{ kind_p } {};
+
+				void* ResolveSlot(const size_t slot_p) {
+					if (slot_p >= registry_.registrations.size() || !registry_.registrations[slot_p].is_registered) {
+						throw std::logic_error("Scope: interface is not registered");
+					}
+					Registration& registration{ registry_.registrations[slot_p] };
+					switch (registration.lifetime) {
+						case Lifetime::kSingleton:
+							if (registration.singleton == nullptr) { return ConstructSingleton(registration); }
+							return registration.singleton;
+						case Lifetime::kThreadLocal:
+							if (kind_ == Kind::kRoot) { throw std::logic_error("Scope: singleton can't depend on thread local instance"); }
+							return ThreadScope(registry_).ResolveOwned(slot_p, registration);
+						case Lifetime::kScoped:
+							if (kind_ != Kind::kRequest) { throw std::logic_error("Scope: scoped instance is resolved outside of request scope"); }
+							return ResolveOwned(slot_p, registration);
+						case Lifetime::kTransient:
+						default:
+							return Construct(registration);
+					}
+				};
+
+				/** Instance, that is owned by this scope: one per scope. */
+				void* ResolveOwned(const size_t slot_p, const Registration& registration_p) {
+					if (slot_p >= instances_.size()) { instances_.resize(registry_.registrations.size()); }
+					if (instances_[slot_p] == nullptr) { instances_[slot_p] = Construct(registration_p); }
+					return instances_[slot_p];
+				};
+
+				void* ConstructSingleton(Registration& registration_p) {
+					if (kind_ != Kind::kRoot || !registry_.is_freezing) { throw std::logic_error("Scope: container is not frozen"); }
+					if (registration_p.is_constructing) { throw std::logic_error("Scope: dependency cycle"); }
+					registration_p.is_constructing = true;
+					try {
+						registration_p.singleton = Construct(registration_p);
+					} catch (...) {
+						registration_p.is_constructing = false;	// Freeze may be repeated
+						throw;
+					}
+					registration_p.is_constructing = false;
+					return registration_p.singleton;
+				};
+
+				void* Construct(const Registration& registration_p) {
+					void* memory{ arena_.allocate(registration_p.size, registration_p.alignment) };	// monotonic: no release on failure
+					void* instance{ registration_p.construct(memory, *this) };
+					destructors_.push_back(Destructor{ registration_p.destroy, memory });
+					return instance;
+				};
+
+				/** Scope of thread local instances of container in calling thread. */
+				static Scope& ThreadScope(Registry& registry_p);
+
+// Data
+				Registry& registry_;
+				const Kind kind_;
+				std::array<std::byte, 1024> buffer_;	// small scope doesn't allocate
+				std::pmr::monotonic_buffer_resource arena_{ buffer_.data(), buffer_.size() };
+				std::pmr::vector<void*> instances_{ &arena_ };	// index is TypeSlot
+				std::pmr::vector<Destructor> destructors_{ &arena_ };
+
+			}; // !class Scope
+
+
+			/**
+			 * Thread scopes of container. Is owned by container and is shared with threads, that use it:
+			 * scope is destroyed at exit of its thread or by ~Container, what is the first.
+			 */
+			struct ThreadScopes {
+				std::mutex mutex{};
+				std::list<std::unique_ptr<Scope>> scopes{};
+				bool is_closed{};	// container is destroyed
+			};
+
+			/**
+			 * Thread local cache is only a lookup: ids of containers are never reused, so entry of destroyed container is never hit.
+			 * Holder of calling thread destroys its scopes at exit of thread, while their containers are alive,
+			 * so new thread never gets instances of exited thread.
+			 */
+			inline Scope& Scope::ThreadScope(Registry& registry_p) {
+				struct Cache {
+					std::uint64_t id{};
+					Scope* scope{};
+				};
+				thread_local Cache cache{};
+				if (cache.id == registry_p.id) [[likely]] { return *cache.scope; }
+
+				struct Holder {
+					struct Entry {
+						std::uint64_t id;
+						Scope* scope;
+						std::weak_ptr<ThreadScopes> owner;
+						std::list<std::unique_ptr<Scope>>::iterator position;
+					};
+
+					~Holder() {
+						for (Entry& entry : entries) {
+							if (const std::shared_ptr<ThreadScopes> owner{ entry.owner.lock() }) {
+								std::lock_guard lock{ owner->mutex };	// container waits: its singletons are alive
+								if (!owner->is_closed) { owner->scopes.erase(entry.position); }
+							}
+						}
+					};
+
+					std::vector<Entry> entries{};
+				};
+				thread_local Holder holder{};
+
+				auto entry{ std::find_if(holder.entries.begin(), holder.entries.end(),
+					[&registry_p](const Holder::Entry& entry_p) { return entry_p.id == registry_p.id; }) };
+				if (entry == holder.entries.end()) {
+					std::erase_if(holder.entries, [](const Holder::Entry& entry_p) { return entry_p.owner.expired(); });
+					holder.entries.reserve(holder.entries.size() + 1);
+					ThreadScopes& owner{ *registry_p.thread_scopes };
+					std::lock_guard lock{ owner.mutex };
+					owner.scopes.push_front(std::unique_ptr<Scope>(new Scope(registry_p, Kind::kThread)));
+					entry = holder.entries.insert(holder.entries.end(),
+						Holder::Entry{ registry_p.id, owner.scopes.front().get(), registry_p.thread_scopes, owner.scopes.begin() });
+				}
+				cache = Cache{ registry_p.id, entry->scope };
+				return *entry->scope;
+			};
+
+
+			/**
+			 * Container of registrations. Register, then Freeze, then Resolve.
+			 * Resolve of container returns singletons and thread local instances. Scoped and transient instances
+			 * are resolved by Scope. After Freeze resolve of singleton is a few loads without lock.
+			 *
+			 * Thread safe after Freeze.
+			 */
+			class Container final {
+			public:
+				Container() : registry_{ NextID() }, root_{ registry_, Scope::Kind::kRoot } {
+					registry_.thread_scopes = std::make_shared<ThreadScopes>();
+				};
+
+				Container(const Container&) = delete;
+				Container& operator=(const Container&) = delete;
+				Container(Container&&) noexcept = delete;
+				Container& operator=(Container&&) noexcept = delete;
+				~Container() {
+					std::lock_guard lock{ registry_.thread_scopes->mutex };
+					registry_.thread_scopes->scopes.clear();	// before root scope: thread local instances may reference singletons
+					registry_.thread_scopes->is_closed = true;
+				};
+
+				/** Register implementation, that is constructed from its Dependencies. */
+				template<typename InterfaceT, typename ImplementationT = InterfaceT>
+				void Register(const Lifetime lifetime_p) {
+					Register<InterfaceT, ImplementationT>(lifetime_p, [](Scope& scope) {
+						return CreateWith<ImplementationT>(scope, typename DependenciesOf<ImplementationT>::type{});
+					});
+					registry_.registrations[TypeSlot<InterfaceT>()].dependencies = SlotsOf(typename DependenciesOf<ImplementationT>::type{});
+				};
+
+				/** Register implementation with factory: ImplementationT(Scope&). */
+				template<typename InterfaceT, typename ImplementationT, typename FactoryT>
+				void Register(const Lifetime lifetime_p, FactoryT factory_p) {
+					static_assert(std::is_convertible_v<ImplementationT*, InterfaceT*>, "Implementation must be derived from interface");
+					if (registry_.is_frozen || registry_.is_freezing) { throw std::logic_error("Container: Register after Freeze"); }
+					const size_t slot{ TypeSlot<InterfaceT>() };
+					if (slot >= registry_.registrations.size()) { registry_.registrations.resize(slot + 1); }
+					Registration& registration{ registry_.registrations[slot] };
+					if (!registration.is_registered) { registry_.order.push_back(slot); }
+					registration = Registration{
+						lifetime_p, sizeof(ImplementationT), alignof(ImplementationT),
+						[factory = std::move(factory_p)](void* memory, Scope& scope) -> void* {
+							ImplementationT* instance{ ::new (memory) ImplementationT(factory(scope)) };
+							return static_cast<void*>(static_cast<InterfaceT*>(instance));
+						},
+						[](void* memory) noexcept { std::destroy_at(static_cast<ImplementationT*>(memory)); },
+						nullptr, true, false };
+				};
+
+				/**
+				 * Check dependency graph, construct singletons in order of registration and close registration.
+				 * Throws std::logic_error on cycle of registrations of any lifetime.
+				 */
+				void Freeze() {
+					if (registry_.is_frozen) { return; }
+					std::vector<Mark> marks(registry_.registrations.size());
+					for (const size_t slot : registry_.order) { CheckCycles(slot, marks); }
+					registry_.is_freezing = true;
+					try {
+						for (const size_t slot : registry_.order) {
+							if (registry_.registrations[slot].lifetime == Lifetime::kSingleton) { root_.ResolveSlot(slot); }
+						}
+					} catch (...) {
+						registry_.is_freezing = false;
+						throw;
+					}
+					registry_.is_freezing = false;
+					registry_.is_frozen = true;
+				};
+
+				/** Singleton or thread local instance. Throws std::logic_error for scoped and transient. */
+				template<typename InterfaceT>
+				InterfaceT& Resolve() {
+					const size_t slot{ TypeSlot<InterfaceT>() };
+					if (slot < registry_.registrations.size()) {
+						const Registration& registration{ registry_.registrations[slot] };
+						if (registration.singleton != nullptr) [[likely]] { return *static_cast<InterfaceT*>(registration.singleton); }
+						if (registration.is_registered && registration.lifetime == Lifetime::kThreadLocal && registry_.is_frozen) {
+							return *static_cast<InterfaceT*>(Scope::ThreadScope(registry_).ResolveOwned(slot, registration));
+						}
+					}
+					throw std::logic_error("Container: interface is not resolved without Scope");
+				};
+
+				inline bool is_frozen() const noexcept { return registry_.is_frozen; };
+
+			private:
+				friend class Scope;
+
+				template<typename ImplementationT, typename... DependenciesT>
+				static ImplementationT CreateWith(Scope& scope_p, Inject<DependenciesT...>) {
+					return ImplementationT(scope_p.Resolve<DependenciesT>()...);
+				};
+
+				template<typename... DependenciesT>
+				static std::vector<size_t> SlotsOf(Inject<DependenciesT...>) { return { TypeSlot<DependenciesT>()... }; };
+
+				enum class Mark : std::uint8_t {
+					kNew,
+					kVisiting,
+					kDone,
+				};
+
+				/** Depth-first search from slot. Dependency on slot, that is being visited, is a cycle. */
+				void CheckCycles(const size_t slot_p, std::vector<Mark>& marks_p) const {
+					if (slot_p >= marks_p.size() || marks_p[slot_p] == Mark::kDone) { return; }
+					if (marks_p[slot_p] == Mark::kVisiting) { throw std::logic_error("Container: dependency cycle"); }
+					marks_p[slot_p] = Mark::kVisiting;
+					for (const size_t dependency : registry_.registrations[slot_p].dependencies) { CheckCycles(dependency, marks_p); }
+					marks_p[slot_p] = Mark::kDone;
+				};
+
+				static std::uint64_t NextID() noexcept {
+					static std::atomic<std::uint64_t> counter{};
+					return counter.fetch_add(1, std::memory_order_relaxed) + 1;	// 0 is empty cache of thread scope
+				};
+
+// Data
+				Registry registry_;
+				Scope root_;	// after registry_
+
+			}; // !class Container
+
+
+			inline Scope::Scope(Container& container_p) : registry_{ container_p.registry_ }, kind_{ Kind::kRequest } {
+				if (!registry_.is_frozen) { throw std::logic_error("Scope: container is not frozen"); }
+			};
+
+		} // !namespace dependency_injection_runtime
+
+
 		namespace dependency_injection_gigachat {
 			/*class IService {
 			public:
@@ -1,7 +1,11 @@
 ﻿#ifndef FACTORY_METHOD_HPP
 #define FACTORY_METHOD_HPP
 
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <utility>
 #include <type_traits>
 
@@ -91,6 +95,217 @@ namespace pattern {
 				};
 			};
 
+
+			/** Creator of product of one type: function pointers and layout. Literal type, is stored in constexpr table. */
+			template<typename IProductT>
+			struct ProductCreator {
+				IProductT* (*construct)(void* memory) {};	// in place
+				IProductT* (*allocate)() {};				// operator new, is deleted by delete
+				size_t size{};
+				size_t alignment{};
+				bool is_registered{};
+
+				template<typename ProductT>
+				static constexpr ProductCreator Of() noexcept {
+					static_assert(std::is_base_of_v<IProductT, ProductT>, "Product must be derived from interface");
+					return ProductCreator{
+						[](void* memory) -> IProductT* { return ::new (memory) ProductT(); },
+						[]() -> IProductT* { return new ProductT(); },
+						sizeof(ProductT), alignof(ProductT), true };
+				};
+			};
+
+			/** Deleter of product, that is created in memory resource. */
+			template<typename IProductT>
+			struct ResourceDeleter {
+				std::pmr::memory_resource* resource{};
+				size_t size{};
+				size_t alignment{};
+
+				void operator()(IProductT* product_ptr) const noexcept {
+					void* memory{ dynamic_cast<void*>(product_ptr) };	// address of most derived object
+					product_ptr->~IProductT();
+					resource->deallocate(memory, size, alignment);
+				};
+			};
+
+
+			template<typename IProductT, typename ProductID_T, size_t kProductsCount>
+			requires std::is_enum_v<ProductID_T>
+			class FactoryTable;
+
+			/**
+			 * Products of one type, that are laid out contiguously in one block of memory resource.
+			 * Destructor destroys products in reverse order and returns block.
+			 */
+			template<typename IProductT>
+			class ProductBlock final {
+			public:
+				ProductBlock() = default;
+				ProductBlock(const ProductBlock&) = delete;
+				ProductBlock& operator=(const ProductBlock&) = delete;
+				ProductBlock(ProductBlock&& other) noexcept { Swap(other); };
+				ProductBlock& operator=(ProductBlock&& other) noexcept {
+					ProductBlock{ std::move(other) }.Swap(*this);
+					return *this;
+				};
+				~ProductBlock() { Reset(); };
+
+				inline IProductT& operator[](const size_t index) const noexcept {
+					return *std::launder(reinterpret_cast<IProductT*>(base_ + index * stride_ + offset_));
+				};
+
+				inline size_t size() const noexcept { return count_; };
+				inline bool empty() const noexcept { return count_ == 0; };
+				/** Distance between products in bytes: sizeof of concrete product. */
+				inline size_t stride() const noexcept { return stride_; };
+
+			private:
+				template<typename IProductU, typename ProductID_U, size_t kCount> requires std::is_enum_v<ProductID_U> friend class FactoryTable;
+
+				void Reset() noexcept {
+					for (size_t index{ count_ }; index > 0; --index) { (*this)[index - 1].~IProductT(); }
+					if (base_ != nullptr) { resource_->deallocate(base_, stride_ * capacity_, alignment_); }
+					base_ = nullptr;
+					count_ = 0;
+				};
+
+				void Swap(ProductBlock& other) noexcept {
+					std::swap(resource_, other.resource_);
+					std::swap(base_, other.base_);
+					std::swap(stride_, other.stride_);
+					std::swap(alignment_, other.alignment_);
+					std::swap(offset_, other.offset_);
+					std::swap(count_, other.count_);
+					std::swap(capacity_, other.capacity_);
+				};
+
+// Data
+				std::pmr::memory_resource* resource_{};
+				std::byte* base_{};
+				size_t stride_{};
+				size_t alignment_{};
+				size_t offset_{};	// of interface inside of concrete product
+				size_t count_{};
+				size_t capacity_{};
+			};
+
+
+			/**
+			 * Table driven Factory Method. Creator of product is found by index of dense enum in array of function pointers:
+			 * no switch and no virtual call. Table can be built at compile time (constexpr) and extended at run time.
+			 * Allocation policy is std::pmr::memory_resource:
+			 * heap (new_delete_resource), arena (monotonic_buffer_resource), pool (unsynchronized_pool_resource),
+			 * or in place into storage of caller (CreateAt).
+			 *
+			 * @tparam kProductsCount	count of values of ProductID_T: 0, 1, ..., kProductsCount - 1
+			 */
+			template<typename IProductT, typename ProductID_T, size_t kProductsCount>
+			requires std::is_enum_v<ProductID_T>
+			class FactoryTable final {
+			public:
+				static_assert(std::has_virtual_destructor_v<IProductT>, "Product is destroyed through interface");
+
+				using ProductPtr = std::unique_ptr<IProductT, ResourceDeleter<IProductT>>;
+
+				constexpr FactoryTable() = default;
+
+				/** Register or replace creator of product id. */
+				template<ProductID_T kProductID, typename ProductT>
+				constexpr FactoryTable& Register() noexcept {
+					static_assert(static_cast<size_t>(kProductID) < kProductsCount, "ProductID is out of table");
+					creators_[static_cast<size_t>(kProductID)] = ProductCreator<IProductT>::template Of<ProductT>();
+					return *this;
+				};
+
+				constexpr bool IsRegistered(const ProductID_T product_id) const noexcept {
+					const size_t index{ static_cast<size_t>(product_id) };
+					return index < kProductsCount && creators_[index].is_registered;
+				};
+
+				/** Size and alignment of storage for CreateAt. 0, if product is not registered. */
+				constexpr size_t size_of(const ProductID_T product_id) const noexcept {
+					return IsRegistered(product_id) ? creators_[static_cast<size_t>(product_id)].size : 0;
+				};
+				constexpr size_t alignment_of(const ProductID_T product_id) const noexcept {
+					return IsRegistered(product_id) ? creators_[static_cast<size_t>(product_id)].alignment : 0;
+				};
+
+				/**
+				 * Construct product in storage of caller. Caller destroys product by ~IProductT().
+				 * @return nullptr, if product is not registered
+				 */
+				IProductT* CreateAt(const ProductID_T product_id, void* memory_p) const {
+					const ProductCreator<IProductT>* creator{ Find(product_id) };
+					return creator ? creator->construct(memory_p) : nullptr;
+				};
+
+				/** Product, that is allocated by operator new. Is compatible with std::unique_ptr<IProductT>. */
+				std::unique_ptr<IProductT> New(const ProductID_T product_id) const {
+					const ProductCreator<IProductT>* creator{ Find(product_id) };
+					return std::unique_ptr<IProductT>{ creator ? creator->allocate() : nullptr };
+				};
+
+				/** Product in memory resource: f.e. arena or pool. Resource must outlive product. */
+				ProductPtr Create(const ProductID_T product_id,
+								  std::pmr::memory_resource* resource_p = std::pmr::new_delete_resource()) const {
+					const ProductCreator<IProductT>* creator{ Find(product_id) };
+					if (creator == nullptr) { return ProductPtr{ nullptr, ResourceDeleter<IProductT>{ resource_p } }; }
+					void* memory{ resource_p->allocate(creator->size, creator->alignment) };
+					try {
+						return ProductPtr{ creator->construct(memory), ResourceDeleter<IProductT>{ resource_p, creator->size, creator->alignment } };
+					} catch (...) {
+						resource_p->deallocate(memory, creator->size, creator->alignment);
+						throw;
+					}
+				};
+
+				/** count_p products of one type in one contiguous block. Empty block, if product is not registered. */
+				ProductBlock<IProductT> CreateN(const ProductID_T product_id, const size_t count_p,
+												std::pmr::memory_resource* resource_p = std::pmr::new_delete_resource()) const {
+					ProductBlock<IProductT> block{};
+					const ProductCreator<IProductT>* creator{ Find(product_id) };
+					if (creator == nullptr || count_p == 0) { return block; }
+
+					block.resource_ = resource_p;
+					block.stride_ = creator->size;
+					block.alignment_ = creator->alignment;
+					block.base_ = static_cast<std::byte*>(resource_p->allocate(creator->size * count_p, creator->alignment));
+					block.capacity_ = count_p;
+					for (size_t index{}; index < count_p; ++index) {	// destructor of block cleans up on exception
+						std::byte* memory{ block.base_ + index * block.stride_ };
+						IProductT* product{ creator->construct(memory) };
+						block.offset_ = static_cast<size_t>(reinterpret_cast<std::byte*>(product) - memory);
+						++block.count_;
+					}
+					return block;
+				};
+
+			private:
+				constexpr const ProductCreator<IProductT>* Find(const ProductID_T product_id) const noexcept {
+					return IsRegistered(product_id) ? &creators_[static_cast<size_t>(product_id)] : nullptr;
+				};
+
+// Data
+				std::array<ProductCreator<IProductT>, kProductsCount> creators_{};
+
+			}; // !class FactoryTable
+
+
+			/** CreatorA without switch: creators are in table, that is built at compile time. */
+			class CreatorTable : public IFactoryMethod<IProduct, ProductID> {
+			public:
+				using TableT = FactoryTable<IProduct, ProductID, 3>;
+
+				static constexpr TableT kTable{ [] {
+					TableT table{};
+					table.Register<ProductID::TA, ProductA>().Register<ProductID::TB, ProductB>().Register<ProductID::TC, ProductC>();
+					return table;
+				}() };
+
+				std::unique_ptr<IProduct> Create(ProductID product_id) const override { return kTable.New(product_id); };
+			};
+
 		} // !namespace factory_method
 
 
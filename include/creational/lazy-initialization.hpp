@@ -1,7 +1,21 @@
 ﻿#ifndef LAZY_INITIALIZATION_HPP
 #define LAZY_INITIALIZATION_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility> // make_pair
 #include <map>
 
@@ -198,8 +212,146 @@ namespace pattern {
 				return 0;
 			}
 
+//==================Variant 3.1 Thread safe Lazy====================================
+
+			/**
+			 * Lazy value: is constructed by factory on the first Get, exactly once, even if Get is called concurrently.
+			 * Value is stored inline, without heap, and is accessed by const reference.
+			 * Ready value costs one acquire load. Threads, that come during construction, are parked by atomic wait
+			 * and are woken by the constructing thread.
+			 * If factory throws, exception is passed to caller of Get and the next Get tries again.
+			 * Prefetch(executor) is a hint: construction starts on background thread and Get joins it,
+			 * so expensive construction is moved off latency sensitive threads. Value, that is never used
+			 * and never hinted, is never constructed.
+			 *
+			 * Thread safe.
+			 *
+			 * @tparam FactoryT callable, that returns T. Is called once.
+			 */
+			template<typename T, typename FactoryT = std::function<T()>>
+			class Lazy final {
+			public:
+				explicit Lazy(FactoryT factory_p) : factory_{ std::move(factory_p) } {};
+
+				Lazy(const Lazy&) = delete;
+				Lazy& operator=(const Lazy&) = delete;
+				Lazy(Lazy&&) noexcept = delete;
+				Lazy& operator=(Lazy&&) noexcept = delete;
+
+				/** Waits for construction on background thread and for the end of its task. */
+				~Lazy() {
+					const std::uint8_t state{ WaitWhileRunning() };
+					// Task notifies waiters after state is set, so it may still use this object
+					while (prefetch_tasks_.load(std::memory_order_acquire) != 0) { std::this_thread::yield(); }
+					if (state == kReady) { std::destroy_at(Pointer()); }
+				};
+
+				/** Value. Constructs it or waits for construction by other thread. */
+				inline const T& Get() const {
+					if (state_.load(std::memory_order_acquire) == kReady) [[likely]] { return *Pointer(); }
+					return Initialize();
+				};
+
+				inline const T& operator*() const { return Get(); };
+				inline const T* operator->() const { return &Get(); };
+
+				/** Value, if it is constructed, otherwise nullptr. Never blocks and never constructs. */
+				inline const T* TryGet() const noexcept {
+					return state_.load(std::memory_order_acquire) == kReady ? Pointer() : nullptr;
+				};
+
+				inline bool is_ready() const noexcept { return state_.load(std::memory_order_acquire) == kReady; };
+
+				/**
+				 * Start construction on executor, if it is not started. Doesn't block.
+				 * If background construction throws, Get constructs again in calling thread and gets exception.
+				 *
+				 * @param executor_p any type with Submit(task), that runs task on other thread. Must outlive task.
+				 * @return false, if value is ready or is being constructed
+				 */
+				template<typename ExecutorT>
+				bool Prefetch(ExecutorT& executor_p) const {
+					std::uint8_t state{ kEmpty };
+					if (!state_.compare_exchange_strong(state, kRunning, std::memory_order_acquire)) { return false; }
+					prefetch_tasks_.fetch_add(1, std::memory_order_relaxed);
+					try {
+						executor_p.Submit([this]() {
+							try { Construct(); } catch (...) {}	// state is reset to kEmpty, Get retries
+							prefetch_tasks_.fetch_sub(1, std::memory_order_release);	// the last access to this
+						});
+					} catch (...) {
+						prefetch_tasks_.fetch_sub(1, std::memory_order_relaxed);
+						if (state_.exchange(kEmpty, std::memory_order_release) == kRunningWaited) { state_.notify_all(); }
+						throw;
+					}
+					return true;
+				};
+
+			private:
+				enum State : std::uint8_t {
+					kEmpty,
+					kRunning,			// one thread constructs
+					kRunningWaited,		// and some threads are parked
+					kReady,
+				};
+
+				inline T* Pointer() const noexcept { return std::launder(reinterpret_cast<T*>(storage_)); };
+
+				/** Slow path: state machine kEmpty -> kRunning -> kReady, or back to kEmpty on exception. */
+				const T& Initialize() const {
+					std::uint8_t state{ state_.load(std::memory_order_acquire) };
+					while (state != kReady) {
+						if (state == kEmpty) {
+							if (state_.compare_exchange_weak(state, kRunning, std::memory_order_acquire)) {
+								Construct();
+								return *Pointer();
+							}
+						} else {	// join construction of other thread
+							state = WaitWhileRunning();
+						}
+					}
+					return *Pointer();
+				};
+
+				/** Park until construction of other thread is finished. @return kEmpty or kReady */
+				std::uint8_t WaitWhileRunning() const noexcept {
+					std::uint8_t state{ state_.load(std::memory_order_acquire) };
+					while (state == kRunning || state == kRunningWaited) {
+						if (state == kRunning) {
+							if (state_.compare_exchange_weak(state, kRunningWaited, std::memory_order_acquire)) { state = kRunningWaited; }
+						} else {
+							state_.wait(kRunningWaited, std::memory_order_acquire);
+							state = state_.load(std::memory_order_acquire);
+						}
+					}
+					return state;
+				};
+
+				void Construct() const {
+					try {
+						::new (static_cast<void*>(storage_)) T(factory_());	// no move: guaranteed copy elision
+					} catch (...) {
+						if (state_.exchange(kEmpty, std::memory_order_release) == kRunningWaited) { state_.notify_all(); }
+						throw;
+					}
+					// notify only if somebody is parked
+					if (state_.exchange(kReady, std::memory_order_acq_rel) == kRunningWaited) { state_.notify_all(); }
+				};
+
+// Data
+				mutable std::atomic<std::uint8_t> state_{ kEmpty };
+				mutable std::atomic<std::uint32_t> prefetch_tasks_{};	// tasks of Prefetch in flight: failed task and next Prefetch may overlap
+				alignas(T) mutable std::byte storage_[sizeof(T)];
+				mutable FactoryT factory_;
+
+			}; // !class Lazy
+
+			template<typename FactoryT>
+			Lazy(FactoryT) -> Lazy<std::invoke_result_t<FactoryT&>, FactoryT>;
+
 //==================Variant 4 Memoization====================================
 
+			// Not thread safe and unbounded, see Memoize.
 			std::map<int, long> fib_cache;
 			inline long fibonacci(int n) {
 				if (fib_cache.count(n)) return fib_cache[n];
@@ -207,6 +359,160 @@ namespace pattern {
 				return fib_cache[n] = fibonacci(n - 1) + fibonacci(n - 2);
 			}
 
+//==================Variant 4.1 Concurrent Memoization====================================
+
+			/** Counters of Memoize. Hit rate is hits / (hits + misses + shared). */
+			struct MemoizeStats {
+				size_t hits{};		// value was cached
+				size_t misses{};	// value was computed
+				size_t shared{};	// value was computed by other thread concurrently, single flight
+				size_t evictions{};
+				size_t size{};		// cached values. Computations in flight are not counted
+			};
+
+			/**
+			 * Memoization of pure function of one argument. Cache is hashed, sharded by key and bounded by LRU.
+			 * Concurrent misses of the same key compute the value once: other threads wait for it (single flight).
+			 * Function is called without lock, so it may call Memoize recursively for other keys (f.e. fibonacci).
+			 * If function throws, exception is passed to all waiters and key is not cached.
+			 *
+			 * Thread safe.
+			 *
+			 * @tparam FunctionT	callable ValueT(const KeyT&) without side effects
+			 * @tparam kShardsCount	power of two
+			 */
+			template<typename FunctionT, typename KeyT,
+					 typename HashT = std::hash<KeyT>, size_t kShardsCount = 16>
+			class Memoize final {
+			public:
+				static_assert(kShardsCount > 0 && (kShardsCount & (kShardsCount - 1)) == 0, "Count of shards must be power of two");
+
+				using ValueT = std::remove_cvref_t<std::invoke_result_t<FunctionT&, const KeyT&>>;
+
+				/** @param capacity_p max count of cached values, is split equally between shards */
+				explicit Memoize(FunctionT function_p, const size_t capacity_p = 1024)
+					: function_{ std::move(function_p) },
+					  shard_capacity_{ std::max<size_t>((capacity_p + kShardsCount - 1) / kShardsCount, 1) } {
+				};
+
+				Memoize(const Memoize&) = delete;
+				Memoize& operator=(const Memoize&) = delete;
+				Memoize(Memoize&&) noexcept = delete;
+				Memoize& operator=(Memoize&&) noexcept = delete;
+				~Memoize() = default;
+
+				/** Cached value or result of function. One lookup on hit. */
+				ValueT operator()(const KeyT& key_p) {
+					Shard& shard{ shards_[HashT{}(key_p) & (kShardsCount - 1)] };
+					std::optional<std::promise<ValueT>> promise{};	// shared state is allocated only on miss
+					{
+						std::unique_lock lock{ shard.mutex };
+						const auto [iterator, is_inserted] = shard.cache.try_emplace(key_p);
+						Entry& entry{ iterator->second };
+						if (!is_inserted) {
+							if (entry.is_ready) {
+								++shard.hits;
+								shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru);
+								return entry.value.get();
+							}
+							++shard.shared;
+							std::shared_future<ValueT> in_flight{ entry.value };
+							lock.unlock();
+							return in_flight.get();	// rethrows exception of computing thread
+						}
+						++shard.misses;
+						try {
+							entry.value = promise.emplace().get_future().share();
+						} catch (...) {
+							shard.cache.erase(iterator);
+							throw;
+						}
+					}
+
+					try {
+						ValueT value{ std::invoke(function_, key_p) };
+						promise->set_value(value);
+					} catch (...) {
+						promise->set_exception(std::current_exception());
+						std::lock_guard lock{ shard.mutex };
+						shard.cache.erase(key_p);
+						throw;
+					}
+
+					std::lock_guard lock{ shard.mutex };
+					const auto iterator{ shard.cache.find(key_p) };
+					shard.lru.push_front(&*iterator);
+					iterator->second.lru = shard.lru.begin();
+					iterator->second.is_ready = true;
+					ValueT value{ iterator->second.value.get() };
+					while (shard.lru.size() > shard_capacity_) {	// only ready values are in LRU list
+						EraseOldest(shard);
+						++shard.evictions;
+					}
+					return value;
+				};
+
+				/** Sum of counters of all shards. Size is count of cached values, computations in flight are not counted. */
+				MemoizeStats stats() const {
+					MemoizeStats stats{};
+					for (const Shard& shard : shards_) {
+						std::lock_guard lock{ shard.mutex };
+						stats.hits += shard.hits;
+						stats.misses += shard.misses;
+						stats.shared += shard.shared;
+						stats.evictions += shard.evictions;
+						stats.size += shard.lru.size();
+					}
+					return stats;
+				};
+
+				/** Drop cached values. Computations in flight are finished and cached. */
+				void Clear() {
+					for (Shard& shard : shards_) {
+						std::lock_guard lock{ shard.mutex };
+						while (!shard.lru.empty()) { EraseOldest(shard); }
+					}
+				};
+
+			private:
+				static constexpr size_t kCacheLineSize{ 64 };
+
+				struct Entry;
+				/** Pointers to elements of cache: they, unlike iterators, are stable on rehash. */
+				using LruT = std::list<std::pair<const KeyT, Entry>*>;
+
+				struct Entry {
+					std::shared_future<ValueT> value{};
+					typename LruT::iterator lru{};	// valid if is_ready
+					bool is_ready{};
+				};
+
+				using CacheT = std::unordered_map<KeyT, Entry, HashT>;
+
+				struct alignas(kCacheLineSize) Shard {	// no false sharing of mutexes
+					mutable std::mutex mutex{};
+					CacheT cache{};
+					LruT lru{};	// the most recently used are in front
+					size_t hits{};
+					size_t misses{};
+					size_t shared{};
+					size_t evictions{};
+				};
+
+				/** Erase the least recently used value by its key. Lock of shard must be held. */
+				static void EraseOldest(Shard& shard_p) {
+					const auto iterator{ shard_p.cache.find(shard_p.lru.back()->first) };
+					shard_p.lru.pop_back();
+					shard_p.cache.erase(iterator);
+				};
+
+// Data
+				FunctionT function_;
+				const size_t shard_capacity_;
+				std::array<Shard, kShardsCount> shards_{};
+
+			}; // !class Memoize
+
 		} // !namespace lazy_evaluation
 
 	} // !namespace creational
@@ -1,8 +1,16 @@
 #ifndef PROTOTYPE_HPP
 #define PROTOTYPE_HPP
 
-#include <memory>
+#include <algorithm>
 #include <concepts>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 /** Software Design Patterns */
 namespace pattern {
@@ -63,6 +71,82 @@ namespace pattern {
 				std::unique_ptr<IPrototype> creator_{};
 			};
 
+
+			/**
+			 * Copy prototype to every object of destination: bulk clone without allocation and virtual call.
+			 * Trivially copyable prototype is copied by memcpy of doubling chunks: log(n) calls of memcpy.
+			 */
+			template<std::copy_constructible PrototypeT>
+			void CloneInto(const PrototypeT& prototype_p, const std::span<PrototypeT> destination_p) {
+				if (destination_p.empty()) { return; }
+				if constexpr (std::is_trivially_copyable_v<PrototypeT>) {
+					std::memcpy(destination_p.data(), std::addressof(prototype_p), sizeof(PrototypeT));
+					for (size_t done{ 1 }; done < destination_p.size();) {
+						const size_t chunk{ std::min(done, destination_p.size() - done) };
+						std::memcpy(destination_p.data() + done, destination_p.data(), chunk * sizeof(PrototypeT));
+						done += chunk;
+					}
+				} else {
+					std::fill(destination_p.begin(), destination_p.end(), prototype_p);
+				}
+			};
+
+			/** Construct count_p clones in raw storage, f.e. buffer of allocator. Caller destroys them. */
+			template<std::copy_constructible PrototypeT>
+			PrototypeT* UninitializedCloneInto(const PrototypeT& prototype_p, void* storage_p, const size_t count_p) {
+				PrototypeT* destination{ static_cast<PrototypeT*>(storage_p) };
+				if constexpr (std::is_trivially_copyable_v<PrototypeT>) {	// implicit lifetime type: memcpy creates objects
+					CloneInto(prototype_p, std::span<PrototypeT>{ destination, count_p });
+				} else {
+					std::uninitialized_fill_n(destination, count_p, prototype_p);
+				}
+				return std::launder(destination);
+			};
+
+
+			/**
+			 * Registry of prototypes of one concrete value type, f.e. templates of entities in spawner.
+			 * Clones are laid out contiguously in buffer of caller (CloneInto) or in vector (CloneN).
+			 *
+			 * Not thread safe for Register. Clone functions are const.
+			 */
+			template<typename KeyT, std::copy_constructible PrototypeT, typename HashT = std::hash<KeyT>>
+			class PrototypeRegistry final {
+			public:
+				/** Register or replace prototype. */
+				void Register(const KeyT& key_p, PrototypeT prototype_p) { prototypes_.insert_or_assign(key_p, std::move(prototype_p)); };
+
+				bool Unregister(const KeyT& key_p) { return prototypes_.erase(key_p) > 0; };
+
+				const PrototypeT* Find(const KeyT& key_p) const {
+					const auto iterator{ prototypes_.find(key_p) };
+					return iterator != prototypes_.end() ? &iterator->second : nullptr;
+				};
+
+				/**
+				 * Clone prototype to all objects of destination.
+				 * @return false, if prototype is not registered
+				 */
+				bool CloneInto(const KeyT& key_p, const std::span<PrototypeT> destination_p) const {
+					const PrototypeT* prototype{ Find(key_p) };
+					if (prototype == nullptr) { return false; }
+					prototype::CloneInto(*prototype, destination_p);
+					return true;
+				};
+
+				/** count_p contiguous clones. Empty, if prototype is not registered. */
+				std::vector<PrototypeT> CloneN(const KeyT& key_p, const size_t count_p) const {
+					const PrototypeT* prototype{ Find(key_p) };
+					if (prototype == nullptr) { return {}; }
+					return std::vector<PrototypeT>(count_p, *prototype);
+				};
+
+				inline size_t size() const noexcept { return prototypes_.size(); };
+
+			private:
+				std::unordered_map<KeyT, PrototypeT, HashT> prototypes_{};
+			};
+
 		} // !namespace prototype
 
 	} // !namespace creational
@@ -1,7 +1,20 @@
 ﻿#ifndef SINGLETON_HPP
 #define SINGLETON_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 
 /** Software Design Patterns */
@@ -28,6 +41,7 @@ namespace pattern {
 			/**
 			 * Class, which can be instantiated only one time. Instance is stored in dynamic memory - heap.
 			 * Code and Data of real class must be inside of Singleton class.
+			 * Not thread safe. Concurrent variant is SingletonConcurrent.
 			 */
 			template<typename SingletonT>
 			class SingletonDynamic {
@@ -58,6 +72,96 @@ namespace pattern {
 			};
 
 
+			/**
+			 * Thread safe SingletonDynamic with explicit lifecycle. Instance is stored in heap.
+			 * GetSingleton after construction is one acquire load and one branch.
+			 * Instance is constructed once, concurrent first calls wait on mutex.
+			 *
+			 * Teardown protocol:
+			 * - reference from GetSingleton may be used until DestructSingleton, which caller calls in quiescent state
+			 *   (f.e. after join of worker threads);
+			 * - Pin from PinSingleton keeps instance alive: DestructSingleton waits until all pins are released.
+			 * GetSingleton after DestructSingleton creates new instance.
+			 *
+			 * @tparam SingletonT concrete class of singleton object
+			 */
+			template<typename SingletonT>
+			class SingletonConcurrent {
+			public:
+				/** Guard of instance. Costs two atomic increments of shared counter, use for rare access during shutdown. */
+				class Pin final {
+				public:
+					Pin() : pinned_ptr_{ Enter() } {};
+					Pin(const Pin&) = delete;
+					Pin& operator=(const Pin&) = delete;
+					Pin(Pin&&) noexcept = delete;
+					Pin& operator=(Pin&&) noexcept = delete;
+					~Pin() { readers_.fetch_sub(1, std::memory_order_release); };
+
+					inline SingletonT& operator*() const noexcept { return *pinned_ptr_; };
+					inline SingletonT* operator->() const noexcept { return pinned_ptr_; };
+
+				private:
+					/** Seq_cst pairs with DestructSingleton: either pin is counted, or pin sees nullptr and constructs new. */
+					static SingletonT* Enter() {
+						readers_.fetch_add(1, std::memory_order_seq_cst);
+						if (SingletonT* instance{ instance_ptr_.load(std::memory_order_seq_cst) }) { return instance; }
+						return &Construct();
+					};
+
+					SingletonT* const pinned_ptr_;
+				};
+
+				/** Defines an class operation that lets clients access its unique instance. */
+				static inline SingletonT& GetSingleton() {
+					if (SingletonT* instance{ instance_ptr_.load(std::memory_order_acquire) }) [[likely]] { return *instance; }
+					return Construct();
+				};
+
+				static inline Pin PinSingleton() { return Pin{}; };
+
+				/** Delete instance. Waits for pins. Unpinned references must not be used concurrently. */
+				static void DestructSingleton() {
+					SingletonT* instance{};
+					{
+						std::lock_guard lock{ mutex_ };
+						instance = instance_ptr_.exchange(nullptr, std::memory_order_seq_cst);
+					}
+					if (instance == nullptr) { return; }
+					while (readers_.load(std::memory_order_seq_cst) != 0) { std::this_thread::yield(); }
+					delete instance;
+				};
+
+				static inline bool IsConstructed() noexcept { return instance_ptr_.load(std::memory_order_acquire) != nullptr; };
+
+			protected:
+				SingletonConcurrent() = default; // no public constructor
+				SingletonConcurrent(const SingletonConcurrent&) = delete; // rule of five
+				SingletonConcurrent& operator=(const SingletonConcurrent&) = delete;
+				SingletonConcurrent(SingletonConcurrent&&) noexcept = delete;
+				SingletonConcurrent& operator=(SingletonConcurrent&&) noexcept = delete;
+				virtual ~SingletonConcurrent() = default; // no public destructor
+
+			private:
+				/** Slow path of the first call. */
+				static SingletonT& Construct() {
+					std::lock_guard lock{ mutex_ };
+					SingletonT* instance{ instance_ptr_.load(std::memory_order_relaxed) };
+					if (instance == nullptr) {
+						instance = new SingletonT();
+						instance_ptr_.store(instance, std::memory_order_release);	// publishes constructed object
+					}
+					return *instance;
+				};
+
+				/** Pointer to the only one object of class. Singleton instance. */
+				inline static std::atomic<SingletonT*> instance_ptr_{ nullptr };
+				inline static std::mutex mutex_{};
+				/** Count of pins. Pin increments it before load of instance, DestructSingleton checks it after exchange. */
+				inline static std::atomic<size_t> readers_{};
+			};
+
+
 			/**
 			 * Class, which can be instantiated only one time. Instance is stored in global memory, static storage duration.
 			 * Code and Data of real class must be inside of Singleton class.
@@ -114,6 +218,7 @@ namespace pattern {
 			/**
 			 * Class, which can be instantiated custom number of time. Instance is stored in global memory, static storage duration.
 			 * Code and Data of real class must be inside of Singleton class.
+			 * Not thread safe: vector is resized inside GetSingleton. For per thread instances use SingletonSharded.
 			 *
 			 * @tparam SingletonT concrete class of singleton object
 			 */
@@ -148,6 +253,83 @@ namespace pattern {
 			};
 
 
+			/**
+			 * Sharded singleton: one instance per shard, every instance is on its own cache lines.
+			 * Count of shards is power of two not less than count of hardware threads.
+			 * Thread gets shard on its first call round-robin, so threads don't share shard while they are
+			 * not more than shards, and their writes don't cause cross-core traffic.
+			 * Global value is Reduce or ForEachShard over all shards: f.e. statistics counters, allocators.
+			 *
+			 * SingletonT is shared by threads, if they are more than shards, and is read by Reduce concurrently,
+			 * so its data must be atomic (relaxed operations are enough for counters) or synchronized.
+			 *
+			 * @tparam SingletonT concrete class of shard, default constructible
+			 */
+			template<typename SingletonT>
+			class SingletonSharded {
+			public:
+				/** Shard of calling thread. After the first call of thread it is one thread_local load and indexing. */
+				static inline SingletonT& GetShard() {
+					thread_local SingletonT* const shard_ptr{
+						&GetShard(next_thread_.fetch_add(1, std::memory_order_relaxed)) };
+					return *shard_ptr;
+				};
+
+				/** Shard by index. Index is wrapped by count of shards. */
+				static inline SingletonT& GetShard(const size_t index) {
+					Shards& shards{ GetShards() };
+					return shards.shards[index & (shards.count - 1)].value;
+				};
+
+				static inline size_t shards_count() { return GetShards().count; };
+
+				/** Call function_p(SingletonT&) for every shard. */
+				template<typename FunctionT>
+				static void ForEachShard(FunctionT&& function_p) {
+					Shards& shards{ GetShards() };
+					for (size_t index{}; index < shards.count; ++index) { function_p(shards.shards[index].value); }
+				};
+
+				/** Fold of shards: result = operation_p(result, const SingletonT&). */
+				template<typename ResultT, typename OperationT>
+				static ResultT Reduce(ResultT init_p, OperationT&& operation_p) {
+					ForEachShard([&init_p, &operation_p](const SingletonT& shard) { init_p = operation_p(std::move(init_p), shard); });
+					return init_p;
+				};
+
+			protected:
+				SingletonSharded() = default; // no public constructor
+				SingletonSharded(const SingletonSharded&) = delete; // rule of five
+				SingletonSharded& operator=(const SingletonSharded&) = delete;
+				SingletonSharded(SingletonSharded&&) noexcept = delete;
+				SingletonSharded& operator=(SingletonSharded&&) noexcept = delete;
+				virtual ~SingletonSharded() = default; // no public destructor
+
+			private:
+				static constexpr size_t kCacheLineSize{ 64 };
+
+				struct alignas(kCacheLineSize) PaddedShard {	// no false sharing of neighbour shards
+					SingletonT value{};
+				};
+
+				struct Shards {
+					size_t count;
+					std::unique_ptr<PaddedShard[]> shards;
+				};
+
+				/** Thread safe initialization of function static. */
+				static Shards& GetShards() {
+					static Shards shards{ [] {
+						const size_t count{ std::bit_ceil(std::max<size_t>(std::thread::hardware_concurrency(), 1)) };
+						return Shards{ count, std::make_unique<PaddedShard[]>(count) };
+					}() };
+					return shards;
+				};
+
+				inline static std::atomic<size_t> next_thread_{};
+			};
+
+
 			class MySingletonStatic : public SingletonStatic<MySingletonStatic> {
 			public:
                 MySingletonStatic() = default; // no public constructor
@@ -174,37 +356,179 @@ namespace pattern {
             };
 
 
-   //         template<typename SingletonT>
-   //         class SingletonRegistry {
-   //         public:
-   //             static SingletonT& GetSingleton() {
-   //                 static SingletonT instance{};
-   //                 return (instance);
-   //             };
-
-			//	static void Register(const char* name, Singleton*);
-			//	static Singleton* Instance();
-			//protected:
-			//	static Singleton* Lookup(const char* name);
-			//private:
-			//	static Singleton* _instance;
-			//	static List<NameSingletonPair>* _registry;
-
-			//	Singleton* Singleton::Instance() {
-			//		if (_instance == 0) {
-			//			const char* singletonName = getenv("SINLETON");
-			//			_instance = Lookup(singletonName);
-			//		}
-			//	}
-
-   //         protected:	// protected for inheritance; private for single class with data
-   //             SingletonRegistry() = default; // There must be only one instance of class, so hidden constructor
-   //             SingletonRegistry(const SingletonRegistry&) = delete;
-   //             SingletonRegistry& operator=(const SingletonRegistry&) = delete;
-   //             SingletonRegistry(SingletonRegistry&&) noexcept = delete;
-   //             SingletonRegistry& operator=(SingletonRegistry&&) noexcept = delete;
-   //             virtual ~SingletonRegistry() = default;
-   //         };
+			/**
+			 * Registry of singletons with dependencies. Replaces lazy initialization on the first hot path call
+			 * by eager initialization at startup.
+			 *
+			 * Register<T, DependenciesT...>(factory) declares singleton and its dependencies.
+			 * Initialize(threads) constructs all singletons in parallel along dependency graph: singleton is constructed,
+			 * when all its dependencies are constructed, so startup time is the critical path of graph.
+			 * Shutdown destroys singletons in reverse topological order, that doesn't depend on thread timing:
+			 * dependents are destroyed before their dependencies.
+			 *
+			 * Factory gets registry and may Get only declared dependencies.
+			 * Register before Initialize, Get after it. Get is thread safe after Initialize.
+			 */
+			class SingletonRegistry final {
+			public:
+				SingletonRegistry() = default;
+				SingletonRegistry(const SingletonRegistry&) = delete;
+				SingletonRegistry& operator=(const SingletonRegistry&) = delete;
+				SingletonRegistry(SingletonRegistry&&) noexcept = delete;
+				SingletonRegistry& operator=(SingletonRegistry&&) noexcept = delete;
+				~SingletonRegistry() { Shutdown(); };
+
+				/** Register singleton, that is default constructed. */
+				template<typename SingletonT, typename... DependenciesT>
+				void Register() {
+					Register<SingletonT, DependenciesT...>([](SingletonRegistry&) { return std::make_unique<SingletonT>(); });
+				};
+
+				/**
+				 * Register singleton with factory: std::unique_ptr<SingletonT>(SingletonRegistry&).
+				 * Dependencies may be registered later, but before Initialize.
+				 */
+				template<typename SingletonT, typename... DependenciesT, typename FactoryT>
+				void Register(FactoryT&& factory_p) {
+					if (is_initialized_) { throw std::logic_error("SingletonRegistry: Register after Initialize"); }
+					const auto [iterator, is_inserted] = indexes_.try_emplace(std::type_index{ typeid(SingletonT) }, nodes_.size());
+					if (!is_inserted) { throw std::logic_error("SingletonRegistry: singleton is already registered"); }
+
+					Node node{};
+					node.dependencies = { std::type_index{ typeid(DependenciesT) }... };
+					node.factory = [factory = std::forward<FactoryT>(factory_p)](SingletonRegistry& registry) -> std::shared_ptr<void> {
+						return std::shared_ptr<SingletonT>{ factory(registry) };
+					};
+					nodes_.push_back(std::move(node));
+				};
+
+				/**
+				 * Construct all registered singletons. Blocks until all are constructed.
+				 * If factory throws, constructed singletons are destroyed and exception is rethrown.
+				 * Throws std::logic_error, if dependency is not registered or graph has cycle.
+				 */
+				void Initialize(const size_t threads_count = std::thread::hardware_concurrency()) {
+					if (is_initialized_) { return; }
+					Plan();
+
+					std::mutex mutex{};
+					std::condition_variable condition{};
+					std::deque<size_t> ready{};
+					size_t finished{};
+					std::exception_ptr exception{};
+					for (size_t index{}; index < nodes_.size(); ++index) {
+						if (nodes_[index].waiting == 0) { ready.push_back(index); }
+					}
+
+					auto worker = [&]() {
+						std::unique_lock lock{ mutex };
+						while (true) {
+							condition.wait(lock, [&]() { return !ready.empty() || finished == nodes_.size() || exception; });
+							if (ready.empty()) { return; }	// all finished or failed
+
+							const size_t index{ ready.front() };
+							ready.pop_front();
+							lock.unlock();
+							std::shared_ptr<void> instance{};
+							std::exception_ptr factory_exception{};
+							try { instance = nodes_[index].factory(*this); } catch (...) { factory_exception = std::current_exception(); }
+							lock.lock();
+
+							++finished;
+							if (factory_exception) {
+								if (!exception) { exception = factory_exception; }
+								ready.clear();
+							} else {
+								nodes_[index].instance = std::move(instance);	// published to dependents by mutex
+								if (!exception) {
+									for (const size_t dependent : nodes_[index].dependents) {
+										if (--nodes_[dependent].waiting == 0) { ready.push_back(dependent); }
+									}
+								}
+							}
+							condition.notify_all();
+						}
+					};
+
+					std::vector<std::thread> threads{};
+					const size_t count{ std::clamp<size_t>(threads_count, 1, std::max<size_t>(nodes_.size(), 1)) };
+					for (size_t thread{ 1 }; thread < count; ++thread) { threads.emplace_back(worker); }
+					worker();	// calling thread works too
+					for (std::thread& thread : threads) { thread.join(); }
+
+					is_initialized_ = true;
+					if (exception) {
+						Shutdown();
+						std::rethrow_exception(exception);
+					}
+				};
+
+				/** Destroy singletons in reverse topological order. Registrations are kept, registry may be initialized again. */
+				void Shutdown() noexcept {
+					if (!is_initialized_) { return; }
+					for (auto index{ order_.rbegin() }; index != order_.rend(); ++index) { nodes_[*index].instance.reset(); }
+					is_initialized_ = false;
+				};
+
+				/** Singleton after Initialize. Throws std::logic_error, if it is not registered or not constructed. */
+				template<typename SingletonT>
+				SingletonT& Get() const {
+					const auto iterator{ indexes_.find(std::type_index{ typeid(SingletonT) }) };
+					if (iterator == indexes_.end() || !nodes_[iterator->second].instance) {
+						throw std::logic_error("SingletonRegistry: singleton is not constructed");
+					}
+					return *static_cast<SingletonT*>(nodes_[iterator->second].instance.get());
+				};
+
+				inline size_t size() const noexcept { return nodes_.size(); };
+				inline bool is_initialized() const noexcept { return is_initialized_; };
+
+			private:
+				struct Node {
+					std::vector<std::type_index> dependencies{};
+					std::function<std::shared_ptr<void>(SingletonRegistry&)> factory{};
+					std::shared_ptr<void> instance{};	// type erased deleter
+					std::vector<size_t> dependents{};
+					size_t waiting{};	// count of dependencies, that are not constructed
+				};
+
+				/** Resolve dependencies, check cycles and compute deterministic topological order for Shutdown. */
+				void Plan() {
+					for (Node& node : nodes_) {
+						node.dependents.clear();
+						node.waiting = node.dependencies.size();
+					}
+					for (size_t index{}; index < nodes_.size(); ++index) {
+						for (const std::type_index& dependency : nodes_[index].dependencies) {
+							const auto iterator{ indexes_.find(dependency) };
+							if (iterator == indexes_.end()) {
+								throw std::logic_error(std::string{ "SingletonRegistry: dependency is not registered: " } + dependency.name());
+							}
+							nodes_[iterator->second].dependents.push_back(index);
+						}
+					}
+
+					// Kahn's algorithm in order of registration
+					order_.clear();
+					std::vector<size_t> waiting(nodes_.size());
+					for (size_t index{}; index < nodes_.size(); ++index) {
+						waiting[index] = nodes_[index].waiting;
+						if (waiting[index] == 0) { order_.push_back(index); }
+					}
+					for (size_t position{}; position < order_.size(); ++position) {
+						for (const size_t dependent : nodes_[order_[position]].dependents) {
+							if (--waiting[dependent] == 0) { order_.push_back(dependent); }
+						}
+					}
+					if (order_.size() != nodes_.size()) { throw std::logic_error("SingletonRegistry: dependency cycle"); }
+				};
+
+// Data
+				std::vector<Node> nodes_{};
+				std::unordered_map<std::type_index, size_t> indexes_{};
+				std::vector<size_t> order_{};	// topological order of construction
+				bool is_initialized_{};
+			};
 
 
 
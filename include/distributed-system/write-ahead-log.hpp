@@ -0,0 +1,416 @@
+﻿#ifndef WRITE_AHEAD_LOG_HPP
+#define WRITE_AHEAD_LOG_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "behavioral/command.hpp"
+#include "support/binary-io.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace distributed_system {
+
+		namespace write_ahead_log {
+			// https://martinfowler.com/articles/patterns-of-distributed-systems/write-ahead-log.html
+			// https://martinfowler.com/articles/patterns-of-distributed-systems/segmented-log.html
+			//
+			// Every state change is appended to the log before it is applied to the state.
+			// After crash the state is rebuilt by replay of the log.
+			// Log is split in segments of fixed size, so old segments can be archived or deleted.
+			// JournalInvoker is the exception: it appends command after execution, see its Class Design.
+			//
+			// Friend patterns: Command - every command is a record of the log.
+
+
+			/** Position in the log. Global byte offset of the end of record. Grows monotonically. */
+			using LSN = std::uint64_t;
+
+
+			using support::MappedFile;
+			using support::ReadValue;
+			using support::WriteValue;
+
+
+			struct LogOptions {
+				/** Size of one segment file. Record can't be bigger than segment. */
+				size_t segment_size{ 1 << 20 };
+
+				/**
+				 * Group commit. Count of records, that are flushed to disk by one sync.
+				 * 1 - sync after every record. 0 - sync only by Sync() and Commit().
+				 */
+				size_t sync_batch_records{ 64 };
+
+				/** Segment file name is: prefix-index.log */
+				std::string segment_prefix{ "segment" };
+			};
+
+
+			/**
+			 * Append-only log, split in memory-mapped segment files of fixed size.
+			 * Segments are preallocated and filled with zeroes, so the end of log is the first zeroed record header.
+			 * Record: [uint32 size][uint32 checksum][payload][padding to 8 bytes].
+			 * Torn record after crash has wrong checksum, so replay stops before it.
+			 *
+			 * Thread safe. Append, Commit and Sync may be called from different threads.
+			 */
+			class SegmentedLog final {
+			public:
+				using RecordHandlerT = std::function<void(std::span<const std::byte>)>;
+
+				explicit SegmentedLog(std::filesystem::path directory_p, LogOptions options_p = {})
+					: directory_{ std::move(directory_p) }, options_{ std::move(options_p) } {
+					if (options_.segment_size <= kHeaderSize) {
+						throw std::invalid_argument("SegmentedLog: segment_size is too small");
+					}
+					std::filesystem::create_directories(directory_);
+					const std::vector<std::uint64_t> segments{ SegmentIndices() };
+					OpenSegment(segments.empty() ? 1 : segments.back());
+					write_offset_ = FindEnd(active_);
+					durable_lsn_ = ToLSN(active_index_, write_offset_);
+				};
+
+				SegmentedLog(const SegmentedLog&) = delete;
+				SegmentedLog& operator=(const SegmentedLog&) = delete;
+				SegmentedLog(SegmentedLog&&) noexcept = delete;
+				SegmentedLog& operator=(SegmentedLog&&) noexcept = delete;
+
+				/** Unsynced records are flushed on destruction. */
+				~SegmentedLog() {
+					try { Sync(); } catch (...) {}
+				};
+
+				/**
+				 * Copy record to the end of log. Record is durable only after sync.
+				 *
+				 * @return LSN of record. Is used in Commit.
+				 */
+				LSN Append(const std::span<const std::byte> record_p) {
+					if (!CanAppend(record_p.size())) {
+						throw std::length_error("SegmentedLog: record is bigger than segment");
+					}
+					const size_t record_size{ RecordSize(record_p.size()) };
+
+					std::lock_guard lock{ mutex_ };
+					if (write_offset_ + record_size > options_.segment_size) { RollSegment(); }
+
+					std::byte* record_ptr{ active_.data() + write_offset_ };
+					const RecordHeader header{ static_cast<std::uint32_t>(record_p.size()), Checksum(record_p) };
+					if (!record_p.empty()) { std::memcpy(record_ptr + kHeaderSize, record_p.data(), record_p.size()); }
+					std::memcpy(record_ptr, &header, kHeaderSize);	// header is the last, it makes record visible
+					write_offset_ += record_size;
+					++unsynced_records_;
+
+					if (options_.sync_batch_records != 0 && unsynced_records_ >= options_.sync_batch_records) {
+						SyncLocked();
+					}
+					return ToLSN(active_index_, write_offset_);
+				};
+
+				/** Record with payload of this size fits in segment. */
+				inline bool CanAppend(const size_t payload_size_p) const noexcept {
+					return RecordSize(payload_size_p) <= options_.segment_size;
+				};
+
+				/**
+				 * Wait until record with lsn_p is durable. Group commit: one sync makes durable
+				 * all records, appended before it by all threads.
+				 */
+				void Commit(const LSN lsn_p) {
+					std::lock_guard lock{ mutex_ };
+					if (lsn_p > durable_lsn_) { SyncLocked(); }
+				};
+
+				/** Flush all appended records to disk. */
+				void Sync() {
+					std::lock_guard lock{ mutex_ };
+					SyncLocked();
+				};
+
+				/**
+				 * Read all valid records from the oldest segment to the end of log.
+				 * Must be called before new appends, f.e. on restart.
+				 *
+				 * @return count of replayed records
+				 */
+				size_t Replay(const RecordHandlerT& handler_p) const {
+					size_t count{};
+					for (const std::uint64_t index : SegmentIndices()) {
+						MappedFile segment{ SegmentPath(index), 0 };
+						size_t offset{};
+						while (const auto record{ ReadRecord(segment, offset) }) {
+							handler_p(*record);
+							offset += RecordSize(record->size());
+							++count;
+						}
+					}
+					return count;
+				};
+
+				inline LSN durable_lsn() const {
+					std::lock_guard lock{ mutex_ };
+					return durable_lsn_;
+				};
+				inline LSN end_lsn() const {
+					std::lock_guard lock{ mutex_ };
+					return ToLSN(active_index_, write_offset_);
+				};
+				inline const std::filesystem::path& directory() const noexcept { return directory_; };
+				inline const LogOptions& options() const noexcept { return options_; };
+
+				/** Indices of all segment files in directory in ascending order. */
+				std::vector<std::uint64_t> SegmentIndices() const {
+					std::vector<std::uint64_t> indices{};
+					const std::string prefix{ options_.segment_prefix + "-" };
+					for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+						const std::string name{ entry.path().filename().string() };
+						if (entry.is_regular_file() && name.starts_with(prefix) && name.ends_with(".log")) {
+							const std::string number{ name.substr(prefix.size(), name.size() - prefix.size() - 4) };
+							if (!number.empty() && std::all_of(number.begin(), number.end(),
+															   [](char c) { return c >= '0' && c <= '9'; })) {
+								indices.push_back(std::stoull(number));
+							}
+						}
+					}
+					std::sort(indices.begin(), indices.end());
+					return indices;
+				};
+
+			private:
+				struct RecordHeader {
+					std::uint32_t size;
+					std::uint32_t checksum;
+				};
+				static constexpr size_t kHeaderSize{ sizeof(RecordHeader) };
+				static constexpr size_t kAlignment{ 8 };
+
+				static constexpr size_t RecordSize(const size_t payload_size) noexcept {
+					return (kHeaderSize + payload_size + kAlignment - 1) / kAlignment * kAlignment;
+				};
+
+				/** FNV-1a. Checksum is never 0, so zeroed memory is never a valid record. */
+				static std::uint32_t Checksum(const std::span<const std::byte> bytes) noexcept {
+					std::uint32_t hash{ 2166136261u };
+					for (const std::byte byte : bytes) {
+						hash = (hash ^ static_cast<std::uint32_t>(byte)) * 16777619u;
+					}
+					return hash == 0 ? 1 : hash;
+				};
+
+				/** @return payload of valid record at offset or nullopt at the end of log */
+				static std::optional<std::span<const std::byte>> ReadRecord(const MappedFile& segment,
+																			const size_t offset) noexcept {
+					if (offset + kHeaderSize > segment.size()) { return std::nullopt; }
+					RecordHeader header{};
+					std::memcpy(&header, segment.data() + offset, kHeaderSize);
+					if (header.checksum == 0 || offset + RecordSize(header.size) > segment.size()) { return std::nullopt; }
+					const std::span<const std::byte> payload{ segment.data() + offset + kHeaderSize, header.size };
+					if (Checksum(payload) != header.checksum) { return std::nullopt; }
+					return payload;
+				};
+
+				static size_t FindEnd(const MappedFile& segment) noexcept {
+					size_t offset{};
+					while (const auto record{ ReadRecord(segment, offset) }) { offset += RecordSize(record->size()); }
+					return offset;
+				};
+
+				inline LSN ToLSN(const std::uint64_t segment_index, const size_t offset) const noexcept {
+					return (segment_index - 1) * options_.segment_size + offset;
+				};
+
+				std::filesystem::path SegmentPath(const std::uint64_t index) const {
+					std::string number{ std::to_string(index) };
+					number.insert(0, 20 - number.size(), '0');	// lexicographic order equals numeric order
+					return directory_ / (options_.segment_prefix + "-" + number + ".log");
+				};
+
+				void OpenSegment(const std::uint64_t index) {
+					active_ = MappedFile{ SegmentPath(index), options_.segment_size };
+					active_index_ = index;
+				};
+
+				/** Active segment is full. Make it durable and continue in the next segment. */
+				void RollSegment() {
+					SyncLocked();
+					OpenSegment(active_index_ + 1);
+					write_offset_ = 0;
+					synced_offset_ = 0;
+				};
+
+				void SyncLocked() {
+					if (write_offset_ > synced_offset_) {
+						active_.Sync(synced_offset_, write_offset_ - synced_offset_);
+						synced_offset_ = write_offset_;
+					}
+					unsynced_records_ = 0;
+					durable_lsn_ = ToLSN(active_index_, write_offset_);
+				};
+
+// Data
+				std::filesystem::path directory_;
+				LogOptions options_;
+
+				mutable std::mutex mutex_{};
+				MappedFile active_{};
+				std::uint64_t active_index_{ 1 };
+				size_t write_offset_{};
+				size_t synced_offset_{};
+				size_t unsynced_records_{};
+				LSN durable_lsn_{};
+
+				/*
+				* Class Design:
+				* Segment is written through memory map, so Append is only memcpy without system calls.
+				* System calls are made only by sync. sync_batch_records defines trade-off
+				* between durability and throughput.
+				*/
+
+			}; // !class SegmentedLog
+
+
+			/** Abstract. Command, that can be written to journal and restored from it. */
+			class IJournaledCommand : public behavioral::command::ICommand {
+			protected:
+				IJournaledCommand() = default;
+				IJournaledCommand(const IJournaledCommand&) = delete; // C.67	C.21
+				IJournaledCommand& operator=(const IJournaledCommand&) = delete;
+				IJournaledCommand(IJournaledCommand&&) noexcept = delete;
+				IJournaledCommand& operator=(IJournaledCommand&&) noexcept = delete;
+			public:
+				~IJournaledCommand() override = default;
+
+				/** Id of command type. Is used to find deserializer on replay. */
+				virtual std::uint32_t TypeID() const noexcept = 0;
+
+				/** Append arguments of command to buffer. */
+				virtual void Serialize(std::vector<std::byte>& buffer_p) const = 0;
+			};
+
+
+			/**
+			 * Invoker, that writes every executed command to the log behind its execution (write-behind).
+			 * On restart the state of receivers is rebuilt by Replay.
+			 * Invariant: every journaled command type must be registered before Replay.
+			 * Durability window: command, that is applied but not appended or not committed, is lost on crash.
+			 * Receivers live in memory and are lost together with it, so restored state is a prefix of executed commands.
+			 *
+			 * Not thread safe, like Invoker. SegmentedLog itself is thread safe.
+			 */
+			class JournalInvoker final {
+			public:
+				using CommandPtrT = std::unique_ptr<behavioral::command::ICommand>;
+				using DeserializerT = std::function<CommandPtrT(std::span<const std::byte>)>;
+
+				explicit JournalInvoker(std::filesystem::path directory_p, LogOptions options_p = {})
+					: log_{ std::move(directory_p), std::move(options_p) } {
+				};
+
+				/** Deserializer creates command from bytes, written by IJournaledCommand::Serialize. */
+				inline void RegisterCommand(const std::uint32_t type_id_p, DeserializerT deserializer_p) {
+					deserializers_[type_id_p] = std::move(deserializer_p);
+				};
+
+				/**
+				 * Serialize command, execute it, then write it to log.
+				 * Command, that throws from Execute, is not written, so Replay never repeats the failure.
+				 * Record is checked before Execute, so executed command is not rejected by the log.
+				 * @return LSN of record. Commit(lsn) waits until command is durable.
+				 */
+				LSN InvokeCommand(IJournaledCommand& command_p) {
+					buffer_.clear();
+					WriteValue(buffer_, command_p.TypeID());
+					command_p.Serialize(buffer_);
+					if (!log_.CanAppend(buffer_.size())) {
+						throw std::length_error("JournalInvoker: record is bigger than segment");
+					}
+					command_p.Execute();
+					return log_.Append(buffer_);
+				};
+
+				/** Execute all journaled commands again. @return count of replayed commands */
+				size_t Replay() {
+					return log_.Replay([this](const std::span<const std::byte> record) {
+						size_t offset{};
+						const auto type_id{ ReadValue<std::uint32_t>(record, offset) };
+						const auto deserializer{ deserializers_.find(type_id) };
+						if (deserializer == deserializers_.end()) {
+							throw std::runtime_error("JournalInvoker: unregistered command type " + std::to_string(type_id));
+						}
+						if (CommandPtrT command{ deserializer->second(record.subspan(offset)) }) { command->Execute(); }
+					});
+				};
+
+				inline void Commit(const LSN lsn_p) { log_.Commit(lsn_p); };
+				inline void Sync() { log_.Sync(); };
+
+				inline SegmentedLog& log() noexcept { return log_; };
+
+			private:
+// Data
+				SegmentedLog log_;
+				std::unordered_map<std::uint32_t, DeserializerT> deserializers_{};
+				/** Reused for serialization, so InvokeCommand doesn't allocate in steady state. */
+				std::vector<std::byte> buffer_{};
+
+				/*
+				* Class Design:
+				* Order is CanAppend, Execute, Append: the log holds only commands, that were executed without exception,
+				* so Replay needs no abort records. Price is a window between Execute and Commit, where executed command
+				* isn't durable yet. Caller, that reports success outside, must Commit(lsn) first.
+				*/
+
+			}; // !class JournalInvoker
+
+
+
+			/** Receiver example. */
+			struct Account {
+				std::int64_t balance{};
+			};
+
+			/** Example of journaled command. */
+			class CommandDeposit : public IJournaledCommand {
+			public:
+				static constexpr std::uint32_t kTypeID{ 1 };
+
+				CommandDeposit(Account& account_p, const std::int64_t amount_p) noexcept
+					: account_{ account_p }, amount_{ amount_p } {
+				};
+
+				inline void Execute() override { account_.balance += amount_; };
+				inline std::uint32_t TypeID() const noexcept override { return kTypeID; };
+				inline void Serialize(std::vector<std::byte>& buffer_p) const override { WriteValue(buffer_p, amount_); };
+
+				/** Deserializer for JournalInvoker::RegisterCommand */
+				static JournalInvoker::CommandPtrT Deserialize(Account& account_p, const std::span<const std::byte> bytes_p) {
+					size_t offset{};
+					return std::make_unique<CommandDeposit>(account_p, ReadValue<std::int64_t>(bytes_p, offset));
+				};
+
+			private:
+				Account& account_;
+				std::int64_t amount_;
+			}; // !class CommandDeposit
+
+		} // !namespace write_ahead_log
+
+	} // !namespace distributed_system
+} // !namespace pattern
+
+#endif // !WRITE_AHEAD_LOG_HPP
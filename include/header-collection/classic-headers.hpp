@@ -29,6 +29,8 @@
 // Behavioral
 #include "behavioral/strategy.hpp"
 #include "behavioral/command.hpp"
+#include "behavioral/command/async-command.hpp"
+#include "behavioral/command/scheduled-command.hpp"
 
 #include "behavioral/observer/generic-observer.hpp"
 #include "behavioral/observer/iobserver.hpp"
@@ -43,6 +45,11 @@
 #include "behavioral/interpreter.hpp"
 #include "behavioral/iterator.hpp"
 #include "behavioral/memento.hpp"
+#include "behavioral/memento/async-memento.hpp"
+#include "behavioral/memento/cow-memento.hpp"
+#include "behavioral/memento/delta-memento.hpp"
+#include "behavioral/memento/memento-pool.hpp"
+#include "behavioral/memento/serialized-memento.hpp"
 #include "behavioral/null-object.hpp"
 
 
@@ -1,6 +1,8 @@
 #ifndef DISTRIBUTED_SYSTEM_HEADERS_HPP
 #define DISTRIBUTED_SYSTEM_HEADERS_HPP
 
+#include "distributed-system/write-ahead-log.hpp"
+
 // https://www.freecodecamp.org/news/design-patterns-for-distributed-systems/
 /*
 Command and Query Responsibility Segregation (CQRS) Pattern
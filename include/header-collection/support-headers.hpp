@@ -4,6 +4,7 @@
 
 // Support headers - all additional headers, that will be used by patterns.
 
+#include "support/binary-io.hpp"
 
 
 #endif // !SUPPORT_HEADERS_HPP
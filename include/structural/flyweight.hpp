@@ -1,8 +1,23 @@
 ﻿#ifndef FLYWEIGHT_HPP
 #define FLYWEIGHT_HPP
 
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+
+#include "structural/flyweight/flat-hash-map.hpp"
+#include "structural/flyweight/string-interner.hpp"
 //#include <algorithm>
 
 /** Software Design Patterns */
@@ -43,35 +58,369 @@ namespace pattern {
 
 			};
 
-			/** Flyweight Cache Fabric class */
-			template<typename CacheKeyT, typename CachedFlyweightT, typename extrinsicStateT>
-			requires std::is_base_of_v<IFlyweight<extrinsicStateT>, CachedFlyweightT>
+			/** Default cache of FlyweightFabric. Node based. */
+			template<typename CacheKeyT, typename ValueT, typename HashT>
+			using UnorderedCacheMap = std::unordered_map<CacheKeyT, ValueT, HashT, std::equal_to<>>;
+
+			/** Flat open addressing cache of FlyweightFabric. No allocation per entry, SIMD probing. */
+			template<typename CacheKeyT, typename ValueT, typename HashT>
+			using FlatCacheMap = FlatHashMap<CacheKeyT, ValueT, HashT, std::equal_to<>>;
+
+
+			/**
+			 * Retention of flyweights, that nobody uses. The most recently released flyweights are kept alive
+			 * by fabric, so repeated requests of the same keys don't reconstruct intrinsic state.
+			 * Budget is for the whole fabric. Flyweights, that are used, are not counted. Zero budgets - no retention.
+			 */
+			struct RetentionOptions {
+				/** Max count of retained flyweights. */
+				size_t max_count{};
+				/** Max bytes of retained flyweights. Size is SizeInBytes() of flyweight, if it is defined, otherwise sizeof. */
+				size_t max_bytes{};
+			};
+
+			/** Counters for sizing of retention. */
+			struct FlyweightStats {
+				size_t hits{};			// flyweight was alive
+				size_t misses{};		// flyweight was created
+				size_t evictions{};		// flyweight was dropped by retention
+				size_t retained_count{};
+				size_t retained_bytes{};
+			};
+
+			template<typename FlyweightT>
+			concept FlyweightWithSize = requires(const FlyweightT& flyweight) {
+				{ flyweight.SizeInBytes() } -> std::convertible_to<size_t>;
+			};
+
+
+			/**
+			 * Flyweight Cache Fabric class. Interning cache: one shared flyweight per key, while somebody uses it.
+			 * Cache is split in shards by hash of key. Each shard has own mutex, so threads, that fetch
+			 * different keys, rarely contend. Lookup of key is single.
+			 * Flyweight is removed from cache by its deleter, when the last shared_ptr is released.
+			 *
+			 * Thread safe. Flyweights may outlive fabric.
+			 *
+			 * Heterogeneous lookup: with transparent HashT, f.e. TransparentStringHash, flyweight of std::string key
+			 * is fetched by std::string_view without copy of key. Key is copied only, when flyweight is created.
+			 * With FlatCacheMap hit doesn't allocate and touches control bytes and one slot.
+			 *
+			 * Optional LRU retention keeps recently released flyweights alive after their last user releases them.
+			 *
+			 * @param kShardsCount count of shards. Power of two.
+			 * @param CacheMapT cache of shard: UnorderedCacheMap or FlatCacheMap
+			 */
+			template<typename CacheKeyT, typename CachedFlyweightT, typename extrinsicStateT,
+					 size_t kShardsCount = 16, typename HashT = std::hash<CacheKeyT>,
+					 template<typename, typename, typename> class CacheMapT = UnorderedCacheMap>
+			requires std::is_base_of_v<IFlyweight<extrinsicStateT>, CachedFlyweightT> &&
+					 (kShardsCount > 0 && (kShardsCount & (kShardsCount - 1)) == 0)
 			class FlyweightFabric {
 			public:
-				// Output can be weak or shared. Depends on who owns cache.
-				std::shared_ptr<CachedFlyweightT> GetFlyweight(CacheKeyT cache_key) {
-					if (cache_.contains(cache_key) && !cache_[cache_key].expired()) { // item has been created
-						return cache_[cache_key].lock();
-					} else {
-						// Deleter, that will clean cache
-						auto deleter = [this, &cache_key](CachedFlyweightT* cached_flyweight_ptr) {
-							this->cache_.erase(cache_key);
-							delete cached_flyweight_ptr;
-						};
-
-						//std::shared_ptr<CachedFlyweightT> ptr{ std::make_shared<CachedFlyweightT>() };
-						std::shared_ptr<CachedFlyweightT> ptr(new CachedFlyweightT(), deleter);
-						cache_[cache_key] = ptr;
-						return ptr;
+				explicit FlyweightFabric(const RetentionOptions retention_p = {})
+					: core_{ std::make_shared<Core>(retention_p) } {
+				};
+
+				/**
+				 * Get shared flyweight of key. Flyweight is created, if there is no alive or retained flyweight of key.
+				 * Flyweight is constructed from key, if it is possible, otherwise by default.
+				 * Output can be weak or shared. Depends on who owns cache.
+				 *
+				 * @param cache_key CacheKeyT or other type for heterogeneous lookup, f.e. std::string_view
+				 */
+				template<typename KeyLikeT = CacheKeyT>
+				requires std::is_constructible_v<CacheKeyT, const KeyLikeT&> &&
+						 std::is_invocable_r_v<size_t, const HashT&, const KeyLikeT&>
+				std::shared_ptr<CachedFlyweightT> GetFlyweight(const KeyLikeT& cache_key) {
+					Shard& shard{ ShardOf(cache_key) };
+					std::lock_guard lock{ shard.mutex };
+					typename CacheT::iterator iterator{};
+					bool is_inserted{};
+					if constexpr (std::is_same_v<KeyLikeT, CacheKeyT> || kHasHeterogeneousInsert<KeyLikeT>) {
+						std::tie(iterator, is_inserted) = shard.cache.try_emplace(cache_key);	// single lookup
+					} else {	// f.e. std::unordered_map before C++26: single lookup on hit
+						iterator = shard.cache.find(cache_key);
+						if (iterator == shard.cache.end()) {
+							iterator = shard.cache.try_emplace(CacheKeyT(cache_key)).first;
+							is_inserted = true;
+						}
+					}
+
+					Entry& entry{ iterator->second };
+					if (!is_inserted) {
+						if (std::shared_ptr<CachedFlyweightT> flyweight{ entry.flyweight.lock() }) {
+							++shard.hits;
+							return flyweight;
+						}
+						if (entry.is_retained) {
+							++shard.hits;
+							return Revive(shard, iterator);
+						}
+					}
+					++shard.misses;
+					try {
+						std::unique_ptr<CachedFlyweightT> created{ Create(iterator->first) };
+						std::shared_ptr<CachedFlyweightT> flyweight{ Share(created, iterator->first) };
+						entry.flyweight = flyweight;
+						return flyweight;
+					} catch (...) {
+						shard.cache.erase(iterator);	// no expired entry without deleter
+						throw;
 					}
 				};
 
+				/** Count of alive flyweights in cache, including retained. */
+				size_t size() const {
+					size_t count{};
+					for (Shard& shard : core_->shards) {
+						std::lock_guard lock{ shard.mutex };
+						count += shard.cache.size();
+					}
+					return count;
+				};
+
+				/** Sum of counters of all shards. */
+				FlyweightStats stats() const {
+					FlyweightStats stats{};
+					for (Shard& shard : core_->shards) {
+						std::lock_guard lock{ shard.mutex };
+						stats.hits += shard.hits;
+						stats.misses += shard.misses;
+						stats.evictions += shard.evictions;
+					}
+					stats.retained_count = core_->retained_count.load(std::memory_order_relaxed);
+					stats.retained_bytes = core_->retained_bytes.load(std::memory_order_relaxed);
+					return stats;
+				};
+
+				/** Drop all retained flyweights. Flyweights, that are used, stay in cache. */
+				void ReleaseRetained() {
+					for (Shard& shard : core_->shards) {
+						RetainedT evicted{};	// is destroyed after unlock
+						std::lock_guard lock{ shard.mutex };
+						while (!shard.retained.empty()) { Evict(*core_, shard, evicted); }
+						UpdateOldest(shard);
+					}
+				};
+
+				static constexpr size_t shards_count() noexcept { return kShardsCount; };
+
 			private:
-				// Can be unoredered_set
-				// Can include option of removing unused cache. CachedFlyweightT = weak_ptr<Object> ???
-				// Without option of removing unused cache. CachedFlyweightT = unique_ptr<Object>
-				// Can be weak or shared
-				std::unordered_map<CacheKeyT, std::weak_ptr<CachedFlyweightT>> cache_{};
+				static constexpr size_t kCacheLineSize{ 64 };
+
+				/** Released flyweight, that is kept alive by fabric. */
+				struct Retained {
+					std::unique_ptr<CachedFlyweightT> flyweight;
+					CacheKeyT cache_key;
+					size_t size_in_bytes;
+					std::uint64_t released_at;	// tick of Core::release_clock
+				};
+
+				static constexpr std::uint64_t kNoRetained{ std::numeric_limits<std::uint64_t>::max() };
+
+				/** The most recently released flyweights are in front. */
+				using RetainedT = std::list<Retained>;
+
+				/** Flyweight of key is either alive (used by somebody) or retained. */
+				struct Entry {
+					std::weak_ptr<CachedFlyweightT> flyweight{};
+					typename RetainedT::iterator retained{};	// valid if is_retained
+					bool is_retained{};
+				};
+
+				using CacheT = CacheMapT<CacheKeyT, Entry, HashT>;
+
+				/** Cache inserts by KeyLikeT without conversion to CacheKeyT on hit, f.e. FlatCacheMap. */
+				template<typename KeyLikeT>
+				static constexpr bool kHasHeterogeneousInsert{ requires(CacheT& cache, const KeyLikeT& key) { cache.try_emplace(key); } };
+
+				struct alignas(kCacheLineSize) Shard {	// no false sharing of mutexes
+					std::mutex mutex{};
+					// Can be unoredered_set
+					// Can include option of removing unused cache. CachedFlyweightT = weak_ptr<Object> ???
+					// Without option of removing unused cache. CachedFlyweightT = unique_ptr<Object>
+					CacheT cache{};
+
+					RetainedT retained{};
+					std::atomic<std::uint64_t> oldest_released{ kNoRetained };	// tick of retained.back(), is read without lock
+					size_t hits{};
+					size_t misses{};
+					size_t evictions{};
+				};
+				using ShardsT = std::array<Shard, kShardsCount>;
+
+				/** Shards and retention budget. Is shared with deleters, so it lives while flyweights are used. */
+				struct Core {
+					explicit Core(const RetentionOptions retention_p) noexcept : retention{ retention_p } {};
+
+					inline bool is_retaining() const noexcept { return retention.max_count != 0 || retention.max_bytes != 0; };
+
+					inline bool is_over_budget() const noexcept {
+						return (retention.max_count != 0 && retained_count.load(std::memory_order_relaxed) > retention.max_count) ||
+							(retention.max_bytes != 0 && retained_bytes.load(std::memory_order_relaxed) > retention.max_bytes);
+					};
+
+					ShardsT shards{};
+					const RetentionOptions retention;
+					std::atomic<size_t> retained_count{};	// of all shards
+					std::atomic<size_t> retained_bytes{};
+					std::atomic<std::uint64_t> release_clock{};	// global order of release
+				};
+
+				/**
+				 * Deleter, that will clean cache or retain released flyweight. Holds copy of key and weak_ptr to core,
+				 * so it is safe after destruction of fabric. Deleter with empty core only deletes flyweight.
+				 */
+				struct Deleter {
+					std::weak_ptr<Core> core;
+					CacheKeyT cache_key;
+
+					void operator()(CachedFlyweightT* cached_flyweight_ptr) const {
+						std::unique_ptr<CachedFlyweightT> released{ cached_flyweight_ptr };
+						RetainedT evicted{};	// is destroyed after unlock
+						if (const std::shared_ptr<Core> core_ptr{ core.lock() }) {
+							Shard& shard{ core_ptr->shards[HashT{}(cache_key) & (kShardsCount - 1)] };
+							{
+								std::lock_guard lock{ shard.mutex };
+								const auto iterator{ shard.cache.find(cache_key) };
+								// Other thread may have already created new flyweight of the same key. It is alive or retained.
+								if (iterator != shard.cache.end() && iterator->second.flyweight.expired() && !iterator->second.is_retained) {
+									if (core_ptr->is_retaining()) {
+										Retain(*core_ptr, shard, iterator->second, Retained{ std::move(released), cache_key, 0, 0 });
+									} else {
+										shard.cache.erase(iterator);
+									}
+								}
+							}
+							if (core_ptr->is_retaining()) { EvictOverBudget(*core_ptr, evicted); }
+						}
+					};
+				};
+
+				static CachedFlyweightT* Create(const CacheKeyT& cache_key) {
+					if constexpr (std::is_constructible_v<CachedFlyweightT, const CacheKeyT&>) {
+						return new CachedFlyweightT(cache_key);
+					} else {
+						return new CachedFlyweightT();
+					}
+				};
+
+				static inline size_t SizeOf(const CachedFlyweightT& flyweight_p) noexcept {
+					if constexpr (FlyweightWithSize<CachedFlyweightT>) {
+						return static_cast<size_t>(flyweight_p.SizeInBytes());
+					} else {
+						return sizeof(CachedFlyweightT);
+					}
+				};
+
+				/** Put released flyweight to front of LRU list of its shard. Shard must be locked. */
+				static void Retain(Core& core_p, Shard& shard_p, Entry& entry_p, Retained&& retained_p) {
+					retained_p.size_in_bytes = SizeOf(*retained_p.flyweight);
+					retained_p.released_at = core_p.release_clock.fetch_add(1, std::memory_order_relaxed);
+					core_p.retained_count.fetch_add(1, std::memory_order_relaxed);
+					core_p.retained_bytes.fetch_add(retained_p.size_in_bytes, std::memory_order_relaxed);
+					shard_p.retained.push_front(std::move(retained_p));
+					entry_p.retained = shard_p.retained.begin();
+					entry_p.is_retained = true;
+					UpdateOldest(shard_p);
+				};
+
+				/**
+				 * While the global budget is exceeded, evict the least recently released flyweight of the whole fabric
+				 * to evicted_p, that is released by caller. Shards must be unlocked: they are locked one at a time.
+				 * Shard with the oldest release is found by oldest_released of shards, without locks: O(kShardsCount).
+				 */
+				static void EvictOverBudget(Core& core_p, RetainedT& evicted_p) {
+					while (core_p.is_over_budget()) {
+						Shard* oldest_shard{};
+						std::uint64_t oldest_released{ kNoRetained };
+						for (Shard& shard : core_p.shards) {
+							if (const std::uint64_t released{ shard.oldest_released.load(std::memory_order_relaxed) }; released < oldest_released) {
+								oldest_released = released;
+								oldest_shard = &shard;
+							}
+						}
+						if (oldest_shard == nullptr) { return; }
+
+						std::lock_guard lock{ oldest_shard->mutex };
+						// Other thread may have revived or evicted it: then the oldest is searched again
+						if (!oldest_shard->retained.empty() && oldest_shard->retained.back().released_at == oldest_released &&
+							core_p.is_over_budget()) {
+							++oldest_shard->evictions;
+							Evict(core_p, *oldest_shard, evicted_p);
+							UpdateOldest(*oldest_shard);
+						}
+					}
+				};
+
+				/** Publish release tick of the oldest retained flyweight of shard. Shard must be locked. */
+				static inline void UpdateOldest(Shard& shard_p) noexcept {
+					shard_p.oldest_released.store(shard_p.retained.empty() ? kNoRetained : shard_p.retained.back().released_at,
+						std::memory_order_relaxed);
+				};
+
+				/** Move the oldest retained flyweight of shard to evicted_p and erase its entry. */
+				static void Evict(Core& core_p, Shard& shard_p, RetainedT& evicted_p) {
+					const Retained& oldest{ shard_p.retained.back() };
+					shard_p.cache.erase(oldest.cache_key);
+					core_p.retained_count.fetch_sub(1, std::memory_order_relaxed);
+					core_p.retained_bytes.fetch_sub(oldest.size_in_bytes, std::memory_order_relaxed);
+					evicted_p.splice(evicted_p.end(), shard_p.retained, std::prev(shard_p.retained.end()));
+				};
+
+				/**
+				 * Move flyweight to shared_ptr with deleter of fabric. Shard of key may be locked:
+				 * control block is created with disarmed deleter, that doesn't lock, and it is armed after.
+				 * If allocation of control block throws, flyweight_p still owns flyweight.
+				 */
+				std::shared_ptr<CachedFlyweightT> Share(std::unique_ptr<CachedFlyweightT>& flyweight_p, const CacheKeyT& cache_key_p) {
+					std::unique_ptr<CachedFlyweightT, Deleter> owner{ flyweight_p.get(), Deleter{ {}, cache_key_p } };
+					flyweight_p.release();
+					try {
+						std::shared_ptr<CachedFlyweightT> flyweight{ std::move(owner) };
+						std::get_deleter<Deleter>(flyweight)->core = core_;
+						return flyweight;
+					} catch (...) {
+						flyweight_p.reset(owner.release());	// constructor of shared_ptr has no effect on failure
+						throw;
+					}
+				};
+
+				/** Give retained flyweight to user again. If it throws, flyweight stays retained. */
+				std::shared_ptr<CachedFlyweightT> Revive(Shard& shard_p, const typename CacheT::iterator iterator_p) {
+					Entry& entry{ iterator_p->second };
+					Retained& retained{ *entry.retained };
+					std::shared_ptr<CachedFlyweightT> flyweight{ Share(retained.flyweight, iterator_p->first) };
+					core_->retained_count.fetch_sub(1, std::memory_order_relaxed);
+					core_->retained_bytes.fetch_sub(retained.size_in_bytes, std::memory_order_relaxed);
+					shard_p.retained.erase(entry.retained);
+					UpdateOldest(shard_p);
+					entry.is_retained = false;
+					entry.flyweight = flyweight;
+					return flyweight;
+				};
+
+				template<typename KeyLikeT>
+				inline Shard& ShardOf(const KeyLikeT& cache_key) const noexcept {
+					return core_->shards[HashT{}(cache_key) & (kShardsCount - 1)];
+				};
+
+// Data
+				std::shared_ptr<Core> core_;
+
+				/*
+				* Class Design:
+				* Flyweight is created under lock of its shard, so two threads never create two flyweights of one key.
+				* Deleter is armed only after the control block is created, so its failure never locks the shard twice.
+				* Deleter erases entry only if it is expired and not retained: entry of key may already hold newer flyweight.
+				* Retention is on release: deleter moves the last released flyweight to LRU list of shard instead of deletion,
+				* so flyweights with owners never take the budget. Count and bytes are global atomics, so budget
+				* is exact for all shards. Order of eviction is global LRU: every release gets tick of one clock,
+				* and eviction takes the shard with the oldest tick, after the releasing shard is unlocked,
+				* so no two shards are locked together. Under concurrent releases the order is approximate.
+				* Evicted flyweights are destroyed after unlock of shard.
+				*/
 			};
 
 
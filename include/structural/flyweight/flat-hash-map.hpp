@@ -0,0 +1,350 @@
+﻿#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace structural {
+		namespace flyweight {
+			// Open addressing hash map with metadata bytes in the style of Swiss Table.
+			// https://abseil.io/about/design/swisstables
+			//
+			// Control byte per slot: empty, deleted or 7 bits of hash of key (h2). Control bytes are probed by groups
+			// of 16 with one SIMD comparison, so lookup touches one cache line of control bytes and usually
+			// one slot. Entries are stored in one array: no allocation per entry.
+
+
+			/** Transparent hash of strings. Lets to look up std::string keys by std::string_view or const char*. */
+			struct TransparentStringHash {
+				using is_transparent = void;
+
+				inline size_t operator()(const std::string_view key_p) const noexcept {
+					return std::hash<std::string_view>{}(key_p);
+				};
+			};
+
+
+			/**
+			 * Flat hash map with heterogeneous lookup: find, try_emplace and erase accept any key type,
+			 * that HashT and EqualT accept (HashT::is_transparent). Key is constructed only on insertion.
+			 * Subset of std::unordered_map interface. Rehash invalidates iterators and references.
+			 *
+			 * @param EqualT must be transparent for heterogeneous lookup, f.e. std::equal_to<>
+			 */
+			template<typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>, typename EqualT = std::equal_to<>>
+			class FlatHashMap final {
+			public:
+				using key_type = KeyT;
+				using mapped_type = ValueT;
+				using value_type = std::pair<const KeyT, ValueT>;
+				using size_type = size_t;
+
+				template<bool kIsConst>
+				class Iterator {
+				public:
+					using MapT = std::conditional_t<kIsConst, const FlatHashMap, FlatHashMap>;
+					using value_type = FlatHashMap::value_type;
+					using reference = std::conditional_t<kIsConst, const value_type&, value_type&>;
+					using pointer = std::conditional_t<kIsConst, const value_type*, value_type*>;
+
+					Iterator() = default;
+					Iterator(MapT* map_p, const size_t index_p) noexcept : map_{ map_p }, index_{ index_p } {};
+					operator Iterator<true>() const noexcept requires (!kIsConst) { return Iterator<true>(map_, index_); };
+
+					inline reference operator*() const noexcept { return *map_->SlotAt(index_); };
+					inline pointer operator->() const noexcept { return map_->SlotAt(index_); };
+
+					Iterator& operator++() noexcept {
+						index_ = map_->NextFull(index_ + 1);
+						return *this;
+					};
+
+					friend inline bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept {
+						return lhs.index_ == rhs.index_;
+					};
+
+				private:
+					friend FlatHashMap;
+
+					MapT* map_{};
+					size_t index_{};
+				};
+
+				using iterator = Iterator<false>;
+				using const_iterator = Iterator<true>;
+
+				FlatHashMap() = default;
+				explicit FlatHashMap(const size_t capacity_p) { reserve(capacity_p); };
+
+				FlatHashMap(const FlatHashMap&) = delete;
+				FlatHashMap& operator=(const FlatHashMap&) = delete;
+				FlatHashMap(FlatHashMap&& other) noexcept { Swap(other); };
+				FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+					if (this != &other) {
+						FlatHashMap old{ std::move(*this) };
+						Swap(other);
+					}
+					return *this;
+				};
+
+				~FlatHashMap() {
+					clear();
+					Deallocate();
+				};
+
+				template<typename KeyLikeT>
+				iterator find(const KeyLikeT& key_p) noexcept {
+					return iterator(this, Find(key_p));
+				};
+
+				template<typename KeyLikeT>
+				const_iterator find(const KeyLikeT& key_p) const noexcept {
+					return const_iterator(this, Find(key_p));
+				};
+
+				template<typename KeyLikeT>
+				inline bool contains(const KeyLikeT& key_p) const noexcept { return Find(key_p) != capacity_; };
+
+				/**
+				 * Insert key and value constructed from args, if there is no key. Single probe.
+				 * KeyT is constructed from key_p only on insertion.
+				 *
+				 * @return iterator to element of key and true, if element was inserted
+				 */
+				template<typename KeyLikeT, typename... ArgsT>
+				std::pair<iterator, bool> try_emplace(KeyLikeT&& key_p, ArgsT&&... args_p) {
+					if (size_ + deleted_ + 1 > capacity_ / 8 * 7) { Rehash(size_ + 1 > capacity_ / 16 * 7 ? capacity_ * 2 : capacity_); }
+					const size_t hash{ Mix(HashT{}(key_p)) };
+					const std::int8_t h2{ H2(hash) };
+					size_t group{ H1(hash) & group_mask_ };
+					size_t insert_index{ capacity_ };
+					for (size_t step{ 1 };; group = (group + step++) & group_mask_) {
+						const std::int8_t* control{ control_ + group * kGroupWidth };
+						for (std::uint32_t mask{ Match(control, h2) }; mask != 0; mask &= mask - 1) {
+							const size_t index{ group * kGroupWidth + static_cast<size_t>(std::countr_zero(mask)) };
+							if (EqualT{}(SlotAt(index)->first, key_p)) { return { iterator(this, index), false }; }
+						}
+						if (insert_index == capacity_) {
+							const std::uint32_t free_mask{ MatchFree(control) };
+							if (free_mask != 0) { insert_index = group * kGroupWidth + static_cast<size_t>(std::countr_zero(free_mask)); }
+						}
+						if (MatchEmpty(control) != 0) { break; }	// key is absent
+					}
+
+					::new (static_cast<void*>(SlotAt(insert_index))) value_type(std::piecewise_construct,
+						std::forward_as_tuple(std::forward<KeyLikeT>(key_p)), std::forward_as_tuple(std::forward<ArgsT>(args_p)...));
+					if (control_[insert_index] == kDeleted) { --deleted_; }
+					control_[insert_index] = h2;
+					++size_;
+					return { iterator(this, insert_index), true };
+				};
+
+				/** Element is marked as deleted. Iterators of other elements stay valid. */
+				void erase(const const_iterator position_p) noexcept {
+					const size_t index{ position_p.index_ };
+					SlotAt(index)->~value_type();
+					control_[index] = kDeleted;
+					--size_;
+					++deleted_;
+				};
+
+				inline void erase(const iterator position_p) noexcept { erase(const_iterator(position_p)); };
+
+				template<typename KeyLikeT>
+				requires (!std::is_convertible_v<const KeyLikeT&, const_iterator>)
+				size_t erase(const KeyLikeT& key_p) noexcept {
+					const size_t index{ Find(key_p) };
+					if (index == capacity_) { return 0; }
+					erase(const_iterator(this, index));
+					return 1;
+				};
+
+				void clear() noexcept {
+					for (size_t index{}; index < capacity_; ++index) {
+						if (control_[index] >= 0) { SlotAt(index)->~value_type(); }
+						control_[index] = kEmpty;
+					}
+					size_ = 0;
+					deleted_ = 0;
+				};
+
+				void reserve(const size_t size_p) {
+					if (size_p > capacity_ / 8 * 7) { Rehash(size_p * 8 / 7 + 1); }
+				};
+
+				inline iterator begin() noexcept { return iterator(this, NextFull(0)); };
+				inline iterator end() noexcept { return iterator(this, capacity_); };
+				inline const_iterator begin() const noexcept { return const_iterator(this, NextFull(0)); };
+				inline const_iterator end() const noexcept { return const_iterator(this, capacity_); };
+
+				inline size_t size() const noexcept { return size_; };
+				inline bool empty() const noexcept { return size_ == 0; };
+				inline size_t capacity() const noexcept { return capacity_; };
+
+			private:
+				static constexpr size_t kGroupWidth{ 16 };
+				static constexpr std::int8_t kEmpty{ -128 };	// 0b10000000
+				static constexpr std::int8_t kDeleted{ -2 };	// 0b11111110. Full slot is 0b0xxxxxxx
+
+				struct alignas(value_type) SlotStorage {
+					std::byte bytes[sizeof(value_type)];
+				};
+
+				/** Spread std::hash of integers, that is identity in most implementations. */
+				static inline size_t Mix(const size_t hash_p) noexcept {
+					return static_cast<size_t>(static_cast<std::uint64_t>(hash_p) * 0x9E3779B97F4A7C15ull);
+				};
+				static inline size_t H1(const size_t hash_p) noexcept { return hash_p >> 7; };
+				static inline std::int8_t H2(const size_t hash_p) noexcept {
+					return static_cast<std::int8_t>(static_cast<std::uint64_t>(hash_p) >> 57);
+				};
+
+#ifdef FLAT_HASH_MAP_SSE2
+				static inline std::uint32_t Match(const std::int8_t* control_p, const std::int8_t h2_p) noexcept {
+					const __m128i group{ _mm_load_si128(reinterpret_cast<const __m128i*>(control_p)) };
+					return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2_p))));
+				};
+				static inline std::uint32_t MatchEmpty(const std::int8_t* control_p) noexcept {
+					return Match(control_p, kEmpty);
+				};
+				/** Empty or deleted: sign bit is set. */
+				static inline std::uint32_t MatchFree(const std::int8_t* control_p) noexcept {
+					const __m128i group{ _mm_load_si128(reinterpret_cast<const __m128i*>(control_p)) };
+					return static_cast<std::uint32_t>(_mm_movemask_epi8(group));
+				};
+#else
+				static inline std::uint32_t Match(const std::int8_t* control_p, const std::int8_t h2_p) noexcept {
+					std::uint32_t mask{};
+					for (size_t i{}; i < kGroupWidth; ++i) { mask |= static_cast<std::uint32_t>(control_p[i] == h2_p) << i; }
+					return mask;
+				};
+				static inline std::uint32_t MatchEmpty(const std::int8_t* control_p) noexcept {
+					return Match(control_p, kEmpty);
+				};
+				static inline std::uint32_t MatchFree(const std::int8_t* control_p) noexcept {
+					std::uint32_t mask{};
+					for (size_t i{}; i < kGroupWidth; ++i) { mask |= static_cast<std::uint32_t>(control_p[i] < 0) << i; }
+					return mask;
+				};
+#endif
+
+				inline value_type* SlotAt(const size_t index) noexcept {
+					return std::launder(reinterpret_cast<value_type*>(slots_[index].bytes));
+				};
+				inline const value_type* SlotAt(const size_t index) const noexcept {
+					return std::launder(reinterpret_cast<const value_type*>(slots_[index].bytes));
+				};
+
+				/** @return index of key or capacity_ */
+				template<typename KeyLikeT>
+				size_t Find(const KeyLikeT& key_p) const noexcept {
+					if (capacity_ == 0) { return capacity_; }
+					const size_t hash{ Mix(HashT{}(key_p)) };
+					const std::int8_t h2{ H2(hash) };
+					size_t group{ H1(hash) & group_mask_ };
+					for (size_t step{ 1 };; group = (group + step++) & group_mask_) {
+						const std::int8_t* control{ control_ + group * kGroupWidth };
+						for (std::uint32_t mask{ Match(control, h2) }; mask != 0; mask &= mask - 1) {
+							const size_t index{ group * kGroupWidth + static_cast<size_t>(std::countr_zero(mask)) };
+							if (EqualT{}(SlotAt(index)->first, key_p)) { return index; }
+						}
+						if (MatchEmpty(control) != 0) { return capacity_; }
+					}
+				};
+
+				size_t NextFull(size_t index) const noexcept {
+					while (index < capacity_ && control_[index] < 0) { ++index; }
+					return index;
+				};
+
+				/** Values are moved by rehash only if nothing can throw after the first move. */
+				static constexpr bool kIsRehashMoveSafe{ std::is_nothrow_copy_constructible_v<KeyT> &&
+					std::is_nothrow_move_constructible_v<ValueT> && std::is_nothrow_invocable_v<HashT, const KeyT&> };
+
+				/**
+				 * Build new arrays with all elements, then commit by swap. Deleted slots are dropped.
+				 * Strong guarantee: values are copied, if key copy, hash or value move may throw.
+				 * Move-only value with throwing move gives basic guarantee, like std::vector.
+				 */
+				void Rehash(size_t capacity_p) {
+					capacity_p = std::bit_ceil(std::max(capacity_p, kGroupWidth));
+					FlatHashMap rehashed{};
+					rehashed.Allocate(capacity_p);
+					for (size_t index{}; index < capacity_; ++index) {
+						if (control_[index] < 0) { continue; }
+						value_type& element{ *SlotAt(index) };
+						if constexpr (kIsRehashMoveSafe || !std::is_copy_constructible_v<ValueT>) {
+							rehashed.try_emplace(element.first, std::move(element.second));	// key is const
+						} else {
+							rehashed.try_emplace(element.first, std::as_const(element.second));	// this map is intact on throw
+						}
+					}
+					Swap(rehashed);	// old elements are destroyed with rehashed
+				};
+
+				void Allocate(const size_t capacity_p) {
+					control_ = static_cast<std::int8_t*>(::operator new(capacity_p, std::align_val_t{ kGroupWidth }));
+					std::memset(control_, static_cast<unsigned char>(kEmpty), capacity_p);
+					slots_ = static_cast<SlotStorage*>(::operator new(capacity_p * sizeof(SlotStorage), std::align_val_t{ alignof(SlotStorage) }));
+					capacity_ = capacity_p;
+					group_mask_ = capacity_p / kGroupWidth - 1;
+				};
+
+				void Deallocate() noexcept {
+					if (control_) { ::operator delete(control_, std::align_val_t{ kGroupWidth }); }
+					if (slots_) { ::operator delete(slots_, std::align_val_t{ alignof(SlotStorage) }); }
+					control_ = nullptr;
+					slots_ = nullptr;
+					capacity_ = 0;
+				};
+
+				void Swap(FlatHashMap& other) noexcept {
+					std::swap(control_, other.control_);
+					std::swap(slots_, other.slots_);
+					std::swap(capacity_, other.capacity_);
+					std::swap(group_mask_, other.group_mask_);
+					std::swap(size_, other.size_);
+					std::swap(deleted_, other.deleted_);
+				};
+
+// Data
+				std::int8_t* control_{};
+				SlotStorage* slots_{};
+				size_t capacity_{};	// power of two, multiple of kGroupWidth
+				size_t group_mask_{};
+				size_t size_{};
+				size_t deleted_{};
+
+				/*
+				* Class Design:
+				* Probing is by groups: quadratic over groups, linear inside group. Lookup stops at the first group
+				* with empty slot, so erase marks slot as deleted, not empty. Deleted slots are reused by insertion
+				* and dropped by rehash.
+				* Rehash copies keys, because key of element is const. Values are moved, when it can't throw,
+				* otherwise they are copied, so exception leaves the map unchanged.
+				*/
+
+			}; // !class FlatHashMap
+
+		} // !namespace flyweight
+	} // !namespace structural
+} // !namespace pattern
+
+#endif // !FLAT_HASH_MAP_HPP
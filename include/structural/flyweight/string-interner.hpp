@@ -0,0 +1,213 @@
+﻿#ifndef STRING_INTERNER_HPP
+#define STRING_INTERNER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "structural/flyweight/flat-hash-map.hpp"
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace structural {
+		namespace flyweight {
+			// String interning. Flyweight of string is its dense integer id: symbol names, tags, column names.
+			// Compared to FlyweightFabric<std::string, ...> there is no control block, refcount and node per string.
+			// Strings are never released: interner lives as long as its ids are used.
+			//
+			// How to use:
+			// StringInterner interner{};
+			// const StringID id{ interner.Intern("column_name") };
+			// std::string_view name{ interner.View(id) };
+
+
+			using StringID = std::uint32_t;
+
+
+			/**
+			 * Interner of strings with dense ids 0, 1, 2, ... in order of first interning.
+			 * Characters are stored back to back in append-only arena, so string_view are stable.
+			 * View(id) is O(1) and lock-free. Intern and Find of new strings are synchronized by shared mutex.
+			 *
+			 * Thread safe.
+			 */
+			class StringInterner final {
+			public:
+				static constexpr StringID kInvalidID{ std::numeric_limits<StringID>::max() };
+
+				explicit StringInterner(const size_t arena_block_size_p = 64 * 1024)
+					: arena_block_size_{ std::max<size_t>(arena_block_size_p, 64) } {
+				};
+
+				StringInterner(const StringInterner&) = delete;
+				StringInterner& operator=(const StringInterner&) = delete;
+				StringInterner(StringInterner&&) noexcept = delete;
+				StringInterner& operator=(StringInterner&&) noexcept = delete;
+
+				~StringInterner() {
+					for (std::atomic<std::string_view*>& segment : segments_) {
+						delete[] segment.load(std::memory_order_relaxed);
+					}
+				};
+
+				/** Id of string. String is copied to arena on the first call. */
+				StringID Intern(const std::string_view string_p) {
+					{
+						std::shared_lock lock{ mutex_ };
+						if (const auto iterator{ ids_.find(string_p) }; iterator != ids_.end()) { return iterator->second; }
+					}
+					std::lock_guard lock{ mutex_ };
+					return InternLocked(string_p);
+				};
+
+				/**
+				 * Intern batch of strings with one exclusive lock.
+				 * @param ids_p	id of strings_p[i] is written to ids_p[i]. Size must be not less than strings_p.size()
+				 */
+				void InternBulk(const std::span<const std::string_view> strings_p, const std::span<StringID> ids_p) {
+					if (ids_p.size() < strings_p.size()) { throw std::invalid_argument("Span of ids is less than span of strings"); }
+					std::lock_guard lock{ mutex_ };
+					ids_.reserve(ids_.size() + strings_p.size());
+					for (size_t i{}; i < strings_p.size(); ++i) { ids_p[i] = InternLocked(strings_p[i]); }
+				};
+
+				std::vector<StringID> InternBulk(const std::span<const std::string_view> strings_p) {
+					std::vector<StringID> ids(strings_p.size());
+					InternBulk(strings_p, ids);
+					return ids;
+				};
+
+				/** Id of string, if it is interned. Doesn't intern. */
+				std::optional<StringID> Find(const std::string_view string_p) const {
+					std::shared_lock lock{ mutex_ };
+					if (const auto iterator{ ids_.find(string_p) }; iterator != ids_.end()) { return iterator->second; }
+					return std::nullopt;
+				};
+
+				/**
+				 * String of id. Lock-free: one load of segment pointer and one load of entry.
+				 * Id must be returned by this interner.
+				 */
+				inline std::string_view View(const StringID id_p) const noexcept {
+					const auto [segment, offset] { Locate(id_p) };
+					return segments_[segment].load(std::memory_order_acquire)[offset];
+				};
+
+				/** View with check of id. Empty, if id is not interned. */
+				inline std::optional<std::string_view> TryView(const StringID id_p) const noexcept {
+					if (id_p >= size_.load(std::memory_order_acquire)) { return std::nullopt; }
+					return View(id_p);
+				};
+
+				/** Count of interned strings. Ids are [0, size()). */
+				inline size_t size() const noexcept { return size_.load(std::memory_order_acquire); };
+
+				/** Memory of arena blocks. */
+				size_t arena_bytes() const {
+					std::shared_lock lock{ mutex_ };
+					return arena_bytes_;
+				};
+
+			private:
+				/** Capacity of segment k is kFirstSegmentSize << k, so 32-bit ids need a few segments. */
+				static constexpr size_t kFirstSegmentSize{ 1024 };
+				static constexpr size_t kSegmentsCount{ 64 - std::countl_zero<std::uint64_t>(
+					(static_cast<std::uint64_t>(kInvalidID) + kFirstSegmentSize - 1) / kFirstSegmentSize) };
+
+				struct Location {
+					size_t segment;
+					size_t offset;
+				};
+
+				static inline Location Locate(const StringID id_p) noexcept {
+					const size_t position{ id_p / kFirstSegmentSize + 1 };
+					const size_t segment{ static_cast<size_t>(std::bit_width(position)) - 1 };
+					return Location{ segment, id_p - kFirstSegmentSize * ((size_t{ 1 } << segment) - 1) };
+				};
+
+				/** Exclusive lock must be held. */
+				StringID InternLocked(const std::string_view string_p) {
+					if (const auto iterator{ ids_.find(string_p) }; iterator != ids_.end()) { return iterator->second; }
+
+					const size_t count{ size_.load(std::memory_order_relaxed) };
+					if (count >= kInvalidID) { throw std::length_error("StringInterner is out of ids"); }
+					const StringID id{ static_cast<StringID>(count) };
+					const std::string_view stored{ Store(string_p) };
+
+					const auto [segment, offset] { Locate(id) };
+					std::string_view* entries{ segments_[segment].load(std::memory_order_relaxed) };
+					if (entries == nullptr) {
+						entries = new std::string_view[kFirstSegmentSize << segment];
+						segments_[segment].store(entries, std::memory_order_release);
+					}
+					entries[offset] = stored;
+					ids_.try_emplace(stored, id);	// key points to arena
+					size_.store(count + 1, std::memory_order_release);	// publishes entry
+					return id;
+				};
+
+				/** Copy characters to arena. Long string gets its own block, rest of current block is kept. */
+				std::string_view Store(const std::string_view string_p) {
+					if (string_p.empty()) { return std::string_view{}; }
+					if (string_p.size() > arena_block_size_ / 4) {
+						char* block{ AllocateBlock(string_p.size()) };
+						std::memcpy(block, string_p.data(), string_p.size());
+						return std::string_view{ block, string_p.size() };
+					}
+					if (string_p.size() > block_left_) {
+						block_cursor_ = AllocateBlock(arena_block_size_);
+						block_left_ = arena_block_size_;
+					}
+					char* data{ block_cursor_ };
+					std::memcpy(data, string_p.data(), string_p.size());
+					block_cursor_ += string_p.size();
+					block_left_ -= string_p.size();
+					return std::string_view{ data, string_p.size() };
+				};
+
+				char* AllocateBlock(const size_t size_p) {
+					blocks_.push_back(std::make_unique_for_overwrite<char[]>(size_p));
+					arena_bytes_ += size_p;
+					return blocks_.back().get();
+				};
+
+// Data
+				const size_t arena_block_size_;
+
+				mutable std::shared_mutex mutex_{};
+				FlatHashMap<std::string_view, StringID, TransparentStringHash> ids_{};
+				std::vector<std::unique_ptr<char[]>> blocks_{};
+				char* block_cursor_{};
+				size_t block_left_{};
+				size_t arena_bytes_{};
+
+				std::array<std::atomic<std::string_view*>, kSegmentsCount> segments_{};
+				std::atomic<size_t> size_{};
+
+				/*
+				* Class Design:
+				* Table of ids is segmented: segments are never moved, so growth doesn't invalidate entries,
+				* that are read without lock. Entry is written before release store of size_ and of new segment pointer.
+				* Reader, that got id from Intern (directly or through other synchronization), sees the entry.
+				*/
+
+			}; // !class StringInterner
+
+		} // !namespace flyweight
+	} // !namespace structural
+} // !namespace pattern
+
+#endif // !STRING_INTERNER_HPP
@@ -0,0 +1,198 @@
+﻿#ifndef BINARY_IO_HPP
+#define BINARY_IO_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+/** Software Design Patterns */
+namespace pattern {
+	namespace support {
+		// Binary storage helpers, that are shared by patterns: memory-mapped file and
+		// serialization of trivially copyable values. F.e. Write-Ahead Log and spill of mementos.
+
+
+		/**
+		 * File mapped in memory for reading and writing.
+		 * File is created, if it doesn't exist, and is extended to size. File is never shrinked.
+		 */
+		class MappedFile final {
+		public:
+			MappedFile() = default;
+
+			/**
+			 * @param path_p file path
+			 * @param size_p minimal size of file. 0 - map the whole existing file.
+			 */
+			MappedFile(const std::filesystem::path& path_p, const size_t size_p) {
+				Open(path_p, size_p);
+			};
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile&& other) noexcept { Swap(other); };
+			MappedFile& operator=(MappedFile&& other) noexcept {
+				if (this != &other) {
+					Close();
+					Swap(other);
+				}
+				return *this;
+			};
+			~MappedFile() { Close(); };
+
+			/** Flush changed bytes [offset, offset + length) to disk. */
+			void Sync(const size_t offset, const size_t length) {
+				if (!data_ || length == 0) { return; }
+				const size_t page{ PageSize() };
+				const size_t begin{ offset / page * page };
+				const size_t end{ std::min(offset + length, size_) };
+#ifdef _WIN32
+				if (!::FlushViewOfFile(data_ + begin, end - begin) || !::FlushFileBuffers(file_)) {
+					ThrowLastError("FlushViewOfFile");
+				}
+#else
+				if (::msync(data_ + begin, end - begin, MS_SYNC) != 0) { ThrowLastError("msync"); }
+#endif
+			};
+
+			void Close() noexcept {
+#ifdef _WIN32
+				if (data_) { ::UnmapViewOfFile(data_); }
+				if (mapping_) { ::CloseHandle(mapping_); }
+				if (file_ != INVALID_HANDLE_VALUE) { ::CloseHandle(file_); }
+				mapping_ = nullptr;
+				file_ = INVALID_HANDLE_VALUE;
+#else
+				if (data_) { ::munmap(data_, size_); }
+				if (fd_ >= 0) { ::close(fd_); }
+				fd_ = -1;
+#endif
+				data_ = nullptr;
+				size_ = 0;
+			};
+
+			inline std::byte* data() noexcept { return data_; };
+			inline const std::byte* data() const noexcept { return data_; };
+			inline size_t size() const noexcept { return size_; };
+			inline bool is_open() const noexcept { return data_ != nullptr; };
+
+		private:
+			void Open(const std::filesystem::path& path_p, size_t size_p) {
+#ifdef _WIN32
+				file_ = ::CreateFileW(path_p.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+									  nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file_ == INVALID_HANDLE_VALUE) { ThrowLastError("CreateFileW"); }
+				LARGE_INTEGER file_size{};
+				::GetFileSizeEx(file_, &file_size);
+				size_ = std::max(static_cast<size_t>(file_size.QuadPart), size_p);
+				if (size_ == 0) { return; }
+				const auto size_64{ static_cast<std::uint64_t>(size_) };
+				mapping_ = ::CreateFileMappingW(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(size_64 >> 32),
+												static_cast<DWORD>(size_64 & 0xFFFFFFFF), nullptr);
+				if (!mapping_) { ThrowLastError("CreateFileMappingW"); }
+				data_ = static_cast<std::byte*>(::MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size_));
+				if (!data_) { ThrowLastError("MapViewOfFile"); }
+#else
+				fd_ = ::open(path_p.c_str(), O_RDWR | O_CREAT, 0644);
+				if (fd_ < 0) { ThrowLastError("open"); }
+				struct stat file_stat {};
+				if (::fstat(fd_, &file_stat) != 0) { ThrowLastError("fstat"); }
+				size_ = std::max(static_cast<size_t>(file_stat.st_size), size_p);
+				if (size_ == 0) { return; }
+				if (static_cast<size_t>(file_stat.st_size) < size_ &&
+					::ftruncate(fd_, static_cast<off_t>(size_)) != 0) { ThrowLastError("ftruncate"); }
+				void* address{ ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0) };
+				if (address == MAP_FAILED) { ThrowLastError("mmap"); }
+				data_ = static_cast<std::byte*>(address);
+#endif
+			};
+
+			void Swap(MappedFile& other) noexcept {
+				std::swap(data_, other.data_);
+				std::swap(size_, other.size_);
+#ifdef _WIN32
+				std::swap(file_, other.file_);
+				std::swap(mapping_, other.mapping_);
+#else
+				std::swap(fd_, other.fd_);
+#endif
+			};
+
+			static size_t PageSize() noexcept {
+#ifdef _WIN32
+				SYSTEM_INFO system_info{};
+				::GetSystemInfo(&system_info);
+				return system_info.dwAllocationGranularity;
+#else
+				return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+			};
+
+			[[noreturn]] static void ThrowLastError(const char* function_name) {
+#ifdef _WIN32
+				const int error_code{ static_cast<int>(::GetLastError()) };
+#else
+				const int error_code{ errno };
+#endif
+				throw std::system_error(error_code, std::system_category(), function_name);
+			};
+
+// Data
+			std::byte* data_{};
+			size_t size_{};
+#ifdef _WIN32
+			HANDLE file_{ INVALID_HANDLE_VALUE };
+			HANDLE mapping_{};
+#else
+			int fd_{ -1 };
+#endif
+		}; // !class MappedFile
+
+
+		/** Append trivially copyable value to byte buffer. Helper for serialization of commands. */
+		template<typename T>
+		requires std::is_trivially_copyable_v<T>
+		inline void WriteValue(std::vector<std::byte>& buffer_p, const T& value_p) {
+			const auto* value_bytes{ reinterpret_cast<const std::byte*>(&value_p) };
+			buffer_p.insert(buffer_p.end(), value_bytes, value_bytes + sizeof(T));
+		};
+
+		/** Read trivially copyable value from bytes and move offset. Helper for deserialization of commands. */
+		template<typename T>
+		requires std::is_trivially_copyable_v<T>
+		inline T ReadValue(const std::span<const std::byte> bytes_p, size_t& offset_p) {
+			if (offset_p + sizeof(T) > bytes_p.size()) {
+				throw std::out_of_range("ReadValue: record is too short");
+			}
+			T value{};
+			std::memcpy(&value, bytes_p.data() + offset_p, sizeof(T));
+			offset_p += sizeof(T);
+			return value;
+		};
+
+	} // !namespace support
+} // !namespace pattern
+
+#endif // !BINARY_IO_HPP
@@ -97,8 +97,197 @@ namespace {
 						//MacroCommandStateful<CommandSTDFunction> macro_stateful{};
 					}
 
+					TEST(CommandTest, UndoHistoryClass) {
+						int value{};
+						int other_value{};
+						UndoHistory history{ 3 };
+
+						history.Execute(std::make_unique<CommandSetValue<int>>(value, 1));
+						history.Execute(std::make_unique<CommandSetValue<int>>(value, 2)); // merged with previous
+						history.Execute(std::make_unique<CommandSetValue<int>>(other_value, 5));
+						EXPECT_EQ(history.size(), 2);
+
+						EXPECT_TRUE(history.Undo());
+						EXPECT_EQ(other_value, 0);
+						EXPECT_TRUE(history.Undo());
+						EXPECT_EQ(value, 0) << "Merged command must revert both edits";
+						EXPECT_FALSE(history.Undo());
+
+						EXPECT_TRUE(history.Redo());
+						EXPECT_EQ(value, 2);
+						EXPECT_EQ(history.redo_count(), 1);
+
+						history.Execute(std::make_unique<CommandSetValue<int>>(other_value, 7)); // discards redo
+						EXPECT_FALSE(history.CanRedo());
+
+						// Capacity: the oldest command is evicted
+						history.BreakMerge();
+						history.Execute(std::make_unique<CommandSetValue<int>>(other_value, 8));
+						history.BreakMerge();
+						history.Execute(std::make_unique<CommandSetValue<int>>(other_value, 9));
+						EXPECT_EQ(history.size(), 3);
+						EXPECT_TRUE(history.Undo());
+						EXPECT_TRUE(history.Undo());
+						EXPECT_TRUE(history.Undo());
+						EXPECT_FALSE(history.Undo());
+						EXPECT_EQ(value, 2);
+						EXPECT_EQ(other_value, 0);
+
+						// Byte budget keeps only one command
+						UndoHistory small_history{ 10, sizeof(CommandSetValue<int>) };
+						small_history.Execute(std::make_unique<CommandSetValue<int>>(value, 3));
+						small_history.Execute(std::make_unique<CommandSetValue<int>>(other_value, 4));
+						EXPECT_EQ(small_history.size(), 1);
+						EXPECT_LE(small_history.size_in_bytes(), small_history.bytes_budget());
+
+						// Clear: the next command is a new step
+						small_history.Clear();
+						small_history.Execute(std::make_unique<CommandSetValue<int>>(value, 5));
+						EXPECT_EQ(small_history.size(), 1);
+						EXPECT_TRUE(small_history.Undo());
+						EXPECT_EQ(value, 3);
+
+						// Moved-from history is empty and usable
+						UndoHistory moved_history{ std::move(small_history) };
+						EXPECT_EQ(moved_history.redo_count(), 1);
+						EXPECT_FALSE(small_history.CanUndo());
+						EXPECT_FALSE(small_history.Redo());
+						small_history.Execute(std::make_unique<CommandSetValue<int>>(value, 6));
+						EXPECT_TRUE(small_history.Undo());
+						EXPECT_EQ(value, 3);
+					}
+
 			} // !namespace command
 
+			namespace command_async {
+				using namespace ::pattern::behavioral::command_async;
+
+				/** Long-latency command. Waits for event, like for completion of I/O. */
+				class CommandWaitEvent : public IAsyncCommand {
+				public:
+					CommandWaitEvent(AsyncEvent& event_p, std::atomic<int>& counter_p) : event_{ event_p }, counter_{ counter_p } {};
+					Task<> Execute() override {
+						co_await event_;
+						++counter_;
+					};
+				private:
+					AsyncEvent& event_;
+					std::atomic<int>& counter_;
+				};
+
+				class CommandIncrement : public IAsyncCommand {
+				public:
+					explicit CommandIncrement(std::atomic<int>& counter_p) : counter_{ counter_p } {};
+					Task<> Execute() override {
+						++counter_;
+						co_return;
+					};
+				private:
+					std::atomic<int>& counter_;
+				};
+
+				TEST(CommandTest, AsyncInvokerClass) {
+					AsyncEvent event{};
+					std::atomic<int> waited_counter{};
+					std::atomic<int> counter{};
+					AsyncInvoker invoker{ 1 };
+
+					std::future<void> waiting{ invoker.InvokeCommand(std::make_shared<CommandWaitEvent>(event, waited_counter)) };
+					// The only worker thread is not blocked by suspended command
+					invoker.InvokeCommand(std::make_shared<CommandIncrement>(counter)).get();
+					EXPECT_EQ(counter, 1);
+					EXPECT_EQ(waited_counter, 0);
+
+					event.Set();
+					waiting.get();
+					EXPECT_EQ(waited_counter, 1);
+
+					auto macro_command{ std::make_shared<AsyncMacroCommand>() };
+					macro_command->commands_.push_back(std::make_shared<CommandIncrement>(counter));
+					macro_command->commands_.push_back(std::make_shared<CommandWaitEvent>(event, waited_counter));
+					macro_command->commands_.push_back(std::make_shared<CommandIncrement>(counter));
+					invoker.InvokeCommand(macro_command).get();
+					EXPECT_EQ(counter, 3);
+					EXPECT_EQ(waited_counter, 2);
+				}
+			} // !namespace command_async
+
+			namespace command_scheduler {
+				using namespace ::pattern::behavioral::command_scheduler;
+				using ::pattern::behavioral::command::Command;
+
+				TEST(CommandTest, SchedulingInvokerClass) {
+					using namespace std::chrono_literals;
+					std::atomic<int> once_counter{};
+					std::atomic<int> periodic_counter{};
+					std::atomic<int> cancelled_counter{};
+					std::atomic<int> many_counter{};
+
+					SchedulingInvoker invoker{ 1ms };
+					// Commands of one driver are executed in order of deadlines, so the last command waits for all previous
+					const auto wait_after{ [&invoker](const std::chrono::milliseconds delay) {
+						std::promise<void> executed{};
+						invoker.Schedule(std::make_shared<Command>([&executed]() { executed.set_value(); }), delay);
+						executed.get_future().wait();
+					} };
+
+					const auto start{ std::chrono::steady_clock::now() };
+					std::atomic<long long> once_delay_ms{};
+					invoker.Schedule(std::make_shared<Command>([&]() {
+						once_delay_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+							std::chrono::steady_clock::now() - start).count();
+						++once_counter;
+					}), 20ms);
+					const TimerHandle cancelled{ invoker.Schedule(std::make_shared<Command>([&]() { ++cancelled_counter; }), 10ms) };
+					EXPECT_TRUE(invoker.Cancel(cancelled));
+					EXPECT_FALSE(invoker.Cancel(cancelled)) << "Handle is invalid after cancellation";
+
+					// Delays cross level 0 of wheel, so commands are cascaded from level 1
+					constexpr int kManyCount{ 2000 };
+					for (int i{}; i < kManyCount; ++i) {
+						invoker.Schedule(std::make_shared<Command>([&]() { ++many_counter; }), std::chrono::milliseconds(1 + i % 300));
+					}
+					wait_after(310ms);
+					EXPECT_EQ(once_counter, 1);
+					EXPECT_GE(once_delay_ms, 20) << "Command mustn't be executed earlier than delay";
+					EXPECT_EQ(cancelled_counter, 0);
+					EXPECT_EQ(many_counter, kManyCount);
+
+					// Periodic command cancels itself in driver thread, so there is no concurrent run
+					std::promise<TimerHandle> periodic_handle{};
+					std::shared_future<TimerHandle> periodic_future{ periodic_handle.get_future() };
+					std::promise<void> periodic_cancelled{};
+					periodic_handle.set_value(invoker.ScheduleEvery(std::make_shared<Command>([&]() {
+						if (++periodic_counter == 5) {
+							EXPECT_TRUE(invoker.Cancel(periodic_future.get()));
+							periodic_cancelled.set_value();
+						}
+					}), 5ms));
+					periodic_cancelled.get_future().wait();
+					wait_after(20ms);
+					EXPECT_EQ(periodic_counter, 5);
+
+					// Periodic commands cancel each other. If both expire in one batch, the second is skipped
+					std::atomic<int> rivals_counter{};
+					std::promise<std::pair<TimerHandle, TimerHandle>> rivals_handles{};
+					std::shared_future<std::pair<TimerHandle, TimerHandle>> rivals_future{ rivals_handles.get_future() };
+					const TimerHandle first_rival{ invoker.ScheduleEvery(std::make_shared<Command>([&]() {
+						++rivals_counter;
+						invoker.Cancel(rivals_future.get().second);
+						invoker.Cancel(rivals_future.get().first);
+					}), 5ms) };
+					const TimerHandle second_rival{ invoker.ScheduleEvery(std::make_shared<Command>([&]() {
+						++rivals_counter;
+						invoker.Cancel(rivals_future.get().first);
+						invoker.Cancel(rivals_future.get().second);
+					}), 5ms) };
+					rivals_handles.set_value({ first_rival, second_rival });
+					wait_after(20ms);
+					EXPECT_EQ(rivals_counter, 1);
+					EXPECT_EQ(invoker.size(), 0);
+				}
+			} // !namespace command_scheduler
+
 			namespace interpreter {}
 			namespace iterator {}
 			namespace mediator {}
@@ -124,6 +313,393 @@ namespace {
                         EXPECT_EQ(my_originator.state_.a, 2);
                         EXPECT_EQ(my_originator.state_.b, 3);
 					};
+
+					TEST(MementoTest, CareTakerRingClass) {
+						using MementoT = Memento<MyOriginator, MyMementoState>;
+						MyOriginator my_originator{};
+						CareTakerRing<MyOriginator, MyMementoState> history{ 3 };
+						for (int i{ 1 }; i <= 5; ++i) {
+							my_originator.state_.a = i;
+							my_originator.CreateMementoIn(history);
+						}
+						EXPECT_EQ(history.size(), 3) << "The oldest mementos must be evicted";
+						EXPECT_EQ(history.Get(3), nullptr);
+
+						my_originator.RestoreByCopy(*history.Get(0));
+						EXPECT_EQ(my_originator.state_.a, 5);
+						my_originator.RestoreByCopy(*history.Get(2));
+						EXPECT_EQ(my_originator.state_.a, 3);
+
+						history.PopNewest();
+						my_originator.RestoreByMove(std::move(*history.Get()));
+						EXPECT_EQ(my_originator.state_.a, 4);
+
+						CareTakerRing<MyOriginator, MyMementoState> small_history{ 10, 2 * sizeof(MementoT) };
+						for (int i{}; i < 5; ++i) { my_originator.CreateMementoIn(small_history); }
+						EXPECT_EQ(small_history.size(), 2) << "Byte budget must evict the oldest mementos";
+						EXPECT_LE(small_history.size_in_bytes(), small_history.bytes_budget());
+					};
+				}
+
+				namespace memento_pool {
+					using namespace ::pattern::behavioral::memento;
+					using namespace ::pattern::behavioral::memento_pool;
+
+					class Buffer final : public AbstractOriginator<Buffer, std::vector<int>>, public OriginatorIdentity {
+					protected:
+						void SetOriginatorState(const std::vector<int>& state_p) override { data_ = state_p; };
+						std::vector<int> GetOriginatorStateValue() const override { return data_; };
+						const std::vector<int>& GetOriginatorStateCRef() const override { return data_; };
+					public:
+						std::vector<int> data_{};
+					};
+
+					TEST(MementoTest, MementoPoolClass) {
+						using PoolT = MementoPool<Buffer, std::vector<int>>;
+						PoolT pool{ 4 };
+						Buffer buffer{};
+						std::vector<PoolT::Handle> handles{};	// mementos are stored contiguously
+						for (int i{}; i < 3; ++i) {
+							buffer.data_.assign(1000, i);
+							handles.push_back(buffer.CreateSnapshotIn(pool));
+						}
+						EXPECT_EQ(pool.size(), 3);
+
+						EXPECT_TRUE(buffer.RestoreFrom(pool, handles[1]));
+						EXPECT_EQ(buffer.data_[999], 1);
+						Buffer other{};
+						EXPECT_FALSE(other.RestoreFrom(pool, handles[1])) << "Only owner can restore";
+						EXPECT_TRUE(other.RestoreFrom(pool, handles[1], false));
+
+						const PoolT::Handle released{ handles[0] };
+						EXPECT_TRUE(pool.Release(released));
+						EXPECT_FALSE(pool.Release(released));
+						buffer.data_.assign(10, 7);
+						const PoolT::Handle recycled{ buffer.CreateSnapshotIn(pool) };
+						EXPECT_EQ(recycled.index, released.index) << "Released slot must be reused";
+						EXPECT_EQ(pool.capacity(), 3);
+						EXPECT_FALSE(buffer.RestoreFrom(pool, released)) << "Old handle of recycled slot must be invalid";
+						EXPECT_TRUE(buffer.RestoreFrom(pool, recycled));
+						EXPECT_EQ(buffer.data_, std::vector<int>(10, 7));
+
+						pool.Clear();
+						EXPECT_EQ(pool.size(), 0);
+						EXPECT_FALSE(pool.IsValid(recycled));
+						EXPECT_FALSE(pool.IsValid(handles[2]));
+					};
+				}
+
+				namespace memento_serialization {
+					using namespace ::pattern::behavioral::memento;
+					using namespace ::pattern::behavioral::memento_serialization;
+
+					struct Layer {
+						std::string name{};
+						std::vector<int> pixels{};
+
+						template<typename SelfT, typename VisitorT>
+						static void VisitFields(SelfT& self, VisitorT&& visitor) { visitor(self.name, self.pixels); };
+					};
+
+					struct Picture {
+						int version{};
+						std::vector<Layer> layers{};
+
+						template<typename SelfT, typename VisitorT>
+						static void VisitFields(SelfT& self, VisitorT&& visitor) { visitor(self.version, self.layers); };
+					};
+
+					class Painter final : public AbstractOriginator<Painter, Picture> {
+					protected:
+						void SetOriginatorState(const Picture& state_p) override { picture_ = state_p; };
+						void SetOriginatorState(Picture&& state_p) override { picture_ = std::move(state_p); };
+						Picture GetOriginatorStateValue() const override { return picture_; };
+						const Picture& GetOriginatorStateCRef() const override { return picture_; };
+					public:
+						Picture picture_{};
+					};
+
+					TEST(MementoTest, SerializationAndCompression) {
+						const Picture picture{ 3, { { "background", std::vector<int>(100, 1) }, { "", { 1, 2, 3 } } } };
+						std::vector<std::byte> buffer{};
+						Serialize(picture, buffer);
+						Picture restored{};
+						Deserialize(restored, buffer);
+						EXPECT_EQ(restored.version, 3);
+						ASSERT_EQ(restored.layers.size(), 2);
+						EXPECT_EQ(restored.layers[0].name, "background");
+						EXPECT_EQ(restored.layers[0].pixels, std::vector<int>(100, 1));
+						EXPECT_EQ(restored.layers[1].pixels, (std::vector<int>{ 1, 2, 3 }));
+						EXPECT_THROW(Deserialize(restored, std::span(buffer).first(buffer.size() - 1)), std::out_of_range);
+
+						std::vector<std::byte> random_bytes(10'000);
+						std::mt19937 generator{ 42 };
+						for (std::byte& byte : random_bytes) { byte = static_cast<std::byte>(generator()); }
+						for (const std::vector<std::byte>& input : { buffer, random_bytes, std::vector<std::byte>{} }) {
+							std::vector<std::byte> compressed{};
+							std::vector<std::byte> decompressed{};
+							FastCompression::Compress(input, compressed);
+							FastCompression::Decompress(compressed, input.size(), decompressed);
+							EXPECT_EQ(decompressed, input);
+						}
+						std::vector<std::byte> compressed{};
+						FastCompression::Compress(buffer, compressed);
+						EXPECT_LT(compressed.size(), buffer.size() / 4) << "Repeated pixels must be compressed";
+						std::vector<std::byte> decompressed{};
+						EXPECT_THROW(FastCompression::Decompress(std::span(compressed).first(compressed.size() / 2), buffer.size(), decompressed),
+									 std::runtime_error);
+					};
+
+					TEST(MementoTest, SpillingCareTakerClass) {
+						constexpr int kSnapshots{ 100 };
+						Painter painter{};
+						SpillingCareTaker<Painter, Picture> history{ { .memory_snapshots = 4, .grow_step = 4096 } };
+						for (int i{}; i < kSnapshots; ++i) {
+							painter.picture_ = Picture{ i, { { "layer " + std::to_string(i), std::vector<int>(10'000, i % 3) } } };
+							painter.CreateSnapshotIn(history);
+						}
+						EXPECT_EQ(history.size(), kSnapshots);
+						EXPECT_EQ(history.memory_snapshots(), 4);
+						EXPECT_EQ(history.spilled_snapshots(), kSnapshots - 4);
+						EXPECT_LT(history.spilled_bytes(), (kSnapshots - 4) * 10'000 * sizeof(int) / 20) << "Spilled snapshots must be compressed";
+
+						for (const int n_recent : { 0, 3, 4, 50, kSnapshots - 1 }) {
+							ASSERT_TRUE(painter.RestoreFrom(history, n_recent));
+							const int version{ kSnapshots - 1 - n_recent };
+							EXPECT_EQ(painter.picture_.version, version);
+							EXPECT_EQ(painter.picture_.layers.at(0).name, "layer " + std::to_string(version));
+							EXPECT_EQ(painter.picture_.layers.at(0).pixels, std::vector<int>(10'000, version % 3));
+						}
+						Painter other{};
+						EXPECT_FALSE(other.RestoreFrom(history, 50)) << "Only owner can restore";
+
+						for (int i{}; i < 10; ++i) { history.PopNewest(); }
+						EXPECT_EQ(history.size(), kSnapshots - 10);
+						ASSERT_TRUE(painter.RestoreFrom(history));
+						EXPECT_EQ(painter.picture_.version, kSnapshots - 11);
+						painter.picture_.version = -1;
+						painter.CreateSnapshotIn(history);
+						ASSERT_TRUE(painter.RestoreFrom(history, 1));
+						EXPECT_EQ(painter.picture_.version, kSnapshots - 11);
+					};
+				}
+
+				namespace memento_static {
+					using namespace ::pattern::behavioral::memento;
+
+					/** Snapshot and restore in tight loop. @return elapsed time and checksum of restored states */
+					template<typename OriginatorT>
+					std::pair<std::chrono::nanoseconds, long long> SnapshotRestoreLoop(OriginatorT& originator, const int iterations) {
+						long long checksum{};
+						const auto start{ std::chrono::steady_clock::now() };
+						for (int i{}; i < iterations; ++i) {
+							originator.state_.a = i;
+							originator.state_.b = -i;
+							auto memento{ originator.CreateMementoByCRef() };
+							originator.state_.a = 0;
+							originator.RestoreByCopy(memento);
+							checksum += originator.state_.a;
+						}
+						return { std::chrono::steady_clock::now() - start, checksum };
+					};
+
+					TEST(MementoTest, StaticOriginatorBenchmark) {
+						constexpr int kIterations{ 1'000'000 };
+						MyOriginator dynamic_originator{};
+						MyStaticOriginator static_originator{};
+
+						const auto [dynamic_time, dynamic_checksum] = SnapshotRestoreLoop(dynamic_originator, kIterations);
+						const auto [static_time, static_checksum] = SnapshotRestoreLoop(static_originator, kIterations);
+						std::cout << "AbstractOriginator (dynamic_cast, virtual): " << dynamic_time.count() / kIterations << " ns/iteration\n";
+						std::cout << "StaticOriginator (CRTP): " << static_time.count() / kIterations << " ns/iteration\n";
+
+						EXPECT_EQ(static_checksum, dynamic_checksum);
+						EXPECT_EQ(static_originator.state_.a, kIterations - 1);
+						EXPECT_EQ(static_originator.state_.b, 1 - kIterations);
+
+						MyStaticOriginator other{};
+						auto memento{ static_originator.CreateMementoByValue() };
+						EXPECT_FALSE(other.RestoreByCopy(memento)) << "Only owner can restore";
+						static_originator.state_.a = 0;
+						EXPECT_TRUE(static_originator.RestoreByMove(std::move(memento)));
+						EXPECT_EQ(static_originator.state_.a, kIterations - 1);
+
+						CareTakerRing<MyStaticOriginator, MyMementoState> history{ 2 };
+						static_originator.CreateMementoIn(history);
+						static_originator.state_.a = 7;
+						static_originator.RestoreByCopy(*history.Get());
+						EXPECT_EQ(static_originator.state_.a, kIterations - 1);
+					};
+				}
+
+				namespace memento_async {
+					using namespace ::pattern::behavioral::memento;
+					using namespace ::pattern::behavioral::memento_async;
+					using ::pattern::behavioral::memento_cow::CowVector;
+
+					using WorldT = CowVector<int>;
+
+					class Simulation final : public AbstractOriginator<Simulation, WorldT> {
+					protected:
+						void SetOriginatorState(const WorldT& state_p) override { world_ = state_p; };
+						WorldT GetOriginatorStateValue() const override { return world_; };
+						const WorldT& GetOriginatorStateCRef() const override { return world_; };
+					public:
+						WorldT world_{};
+					};
+
+					TEST(MementoTest, CreateMementoAsync) {
+						Simulation simulation{};
+						simulation.world_.resize(1 << 20, 1);
+						SnapshotWorker worker{};
+						std::promise<void> writer_resumed{};
+
+						// Autosave: sum as a stand in for serialization, waits for writer to show it is not blocked
+						std::future<long long> saved{ simulation.CreateMementoAsync(worker,
+							[resumed = writer_resumed.get_future()](WorldT&& world_p) mutable {
+								resumed.wait();
+								long long sum{};
+								for (size_t i{}; i < world_p.size(); ++i) { sum += world_p[i]; }
+								return sum;
+							}) };
+						for (size_t i{}; i < simulation.world_.size(); i += 1000) { simulation.world_.Set(i, 0); }
+						writer_resumed.set_value();
+						EXPECT_EQ(saved.get(), 1 << 20) << "Snapshot must not see mutations after capture";
+
+						auto memento_future{ simulation.CreateMementoAsync(worker) };
+						simulation.world_.Set(1, 5);
+						auto memento{ memento_future.get() };
+						EXPECT_TRUE(simulation.RestoreByCopy(*memento));
+						EXPECT_EQ(simulation.world_[1], 1);
+						EXPECT_EQ(simulation.world_[1000], 0);
+
+						std::future<int> failed{ worker.Submit([]() -> int { throw std::runtime_error("disk is full"); }) };
+						EXPECT_THROW(failed.get(), std::runtime_error);
+					};
+				}
+
+				namespace memento_delta {
+					using namespace ::pattern::behavioral::memento;
+					using namespace ::pattern::behavioral::memento_delta;
+
+					class Document final : public AbstractOriginator<Document, std::vector<int>> {
+					protected:
+						void SetOriginatorState(const std::vector<int>& state_p) override { data_ = state_p; };
+						void SetOriginatorState(std::vector<int>&& state_p) override { data_ = std::move(state_p); };
+						std::vector<int> GetOriginatorStateValue() const override { return data_; };
+						const std::vector<int>& GetOriginatorStateCRef() const override { return data_; };
+					public:
+						std::vector<int> data_{};
+					};
+
+					TEST(MementoTest, DeltaCareTakerClass) {
+						constexpr size_t kStateSize{ 100'000 };
+						constexpr size_t kSnapshots{ 20 };
+						Document document{};
+						document.data_.assign(kStateSize, 0);
+						DeltaCareTaker<Document, std::vector<int>> history{ { .block_size = 256, .keyframe_interval = 8 } };
+						for (size_t i{}; i < kSnapshots; ++i) {
+							document.data_[(i * 7919) % kStateSize] = static_cast<int>(i + 1);
+							document.CreateSnapshotIn(history);
+						}
+						EXPECT_EQ(history.size(), kSnapshots);
+						// 3 keyframes and 17 deltas of one block instead of 20 full copies
+						EXPECT_LT(history.size_in_bytes(), 4 * kStateSize * sizeof(int));
+
+						for (size_t n_recent{}; n_recent < kSnapshots; ++n_recent) {
+							ASSERT_TRUE(document.RestoreFrom(history, n_recent));
+							const size_t last{ kSnapshots - 1 - n_recent };
+							for (size_t i{}; i < kSnapshots; ++i) {
+								EXPECT_EQ(document.data_[(i * 7919) % kStateSize], i <= last ? static_cast<int>(i + 1) : 0);
+							}
+						}
+						EXPECT_FALSE(document.RestoreFrom(history, kSnapshots));
+						Document other{};
+						EXPECT_FALSE(other.RestoreFrom(history)) << "Only owner can restore";
+
+						history.PopNewest();
+						document.data_[0] = -1;
+						document.CreateSnapshotIn(history);
+						ASSERT_TRUE(document.RestoreFrom(history, 1));
+						EXPECT_EQ(document.data_[0], 1) << "Delta after PopNewest must be made against the new newest snapshot";
+
+						DeltaCareTaker<Document, std::vector<int>> short_history{ { .keyframe_interval = 4, .max_snapshots = 3 } };
+						for (int i{ 1 }; i <= 10; ++i) {
+							document.data_[0] = i;
+							document.CreateSnapshotIn(short_history);
+						}
+						EXPECT_EQ(short_history.size(), 3);
+						for (size_t n_recent{}; n_recent < 3; ++n_recent) {
+							ASSERT_TRUE(document.RestoreFrom(short_history, n_recent));
+							EXPECT_EQ(document.data_[0], static_cast<int>(10 - n_recent)) << "Evicted keyframe must be rebuilt";
+						}
+					};
+				}
+
+				namespace memento_cow {
+					using namespace ::pattern::behavioral::memento;
+					using namespace ::pattern::behavioral::memento_cow;
+
+					using TextT = CowVector<char, 1024>;
+
+					class TextEditor final : public AbstractOriginator<TextEditor, TextT> {
+					protected:
+						void SetOriginatorState(const TextT& state_p) override { text_ = state_p; };
+						void SetOriginatorState(TextT&& state_p) override { text_ = std::move(state_p); };
+						TextT GetOriginatorStateValue() const override { return text_; };
+						const TextT& GetOriginatorStateCRef() const override { return text_; };
+					public:
+						TextT text_{};
+					};
+
+					TEST(MementoTest, CowVectorState) {
+						TextEditor editor{};
+						editor.text_.resize(1 << 20, 'a');
+						CareTakerRing<TextEditor, TextT> history{ 100 };
+						for (size_t i{}; i < 50; ++i) {	// snapshot per keystroke
+							editor.CreateMementoIn(history);
+							editor.text_.Set(i * 10'000, 'b');
+						}
+						// snapshot owns only its table of chunk pointers and the chunk, edited since the previous snapshot
+						EXPECT_LT(history.Get(0)->SizeInBytes(), editor.text_.size() / 32);
+						EXPECT_LT(history.size_in_bytes(), editor.text_.size() * 2) << "50 snapshots cost less than 2 copies";
+						const TextT current{ editor.text_ };
+						const size_t chunk_count{ current.chunk_count() };
+
+						editor.RestoreByCopy(*history.Get(49));
+						EXPECT_EQ(editor.text_.size(), size_t{ 1 } << 20);
+						EXPECT_EQ(editor.text_[0], 'a');
+						// 50 edits touched at most 50 chunks: the rest is shared with the first snapshot
+						EXPECT_GE(editor.text_.SharedChunksWith(current), chunk_count - 50);
+
+						editor.RestoreByCopy(*history.Get(0));
+						EXPECT_EQ(editor.text_[0], 'b');
+						EXPECT_EQ(editor.text_[49 * 10'000], 'a');
+						EXPECT_EQ(editor.text_.SharedChunksWith(current), chunk_count - 1);
+
+						editor.text_.Set(0, 'c');
+						EXPECT_FALSE(editor.text_ == current);
+						editor.RestoreByCopy(*history.Get(0));
+						EXPECT_EQ(editor.text_[0], 'b') << "Snapshot must not see later edits";
+					};
+
+					TEST(MementoTest, CowVectorBudget) {
+						TextEditor editor{};
+						editor.text_.resize(1 << 20, 'a');
+						const size_t state_bytes{ editor.text_.size() };
+						CareTakerRing<TextEditor, TextT> history{ 100, state_bytes * 3 / 2 };
+						for (size_t i{}; i < 3; ++i) { editor.CreateMementoIn(history); }
+						EXPECT_EQ(history.size(), 3) << "Snapshots share chunks with editor";
+						EXPECT_LT(history.size_in_bytes(), state_bytes * 11 / 10) << "Shared version is charged once";
+
+						// Editor rewrites all chunks after snapshots: old chunks are left only in snapshots
+						for (size_t i{}; i < editor.text_.size(); i += TextT::chunk_size()) { editor.text_.Set(i, 'b'); }
+						editor.CreateMementoIn(history);
+						EXPECT_LT(history.size(), 4) << "Snapshots, that own old chunks, must be evicted by budget";
+						EXPECT_LE(history.size_in_bytes(), history.bytes_budget());
+						editor.RestoreByCopy(*history.Get(0));
+						EXPECT_EQ(editor.text_[0], 'b');
+					};
 				}
 
 				/*namespace memento_templated {
@@ -618,9 +1194,431 @@ namespace {
 		namespace creational {
 			namespace abstract_factory{}
 			namespace builder {}
-			namespace dependency_injection {}
-			namespace factory_method {}
-			namespace lazy_initialization {}
+			namespace dependency_injection {
+				namespace static_wiring {
+					using namespace ::pattern::creational::dependency_injection_static;
+
+					std::vector<std::string> events{};
+
+					struct LoggerTag {};
+
+					class MemoryLogger {
+					public:
+						MemoryLogger() { events.push_back("+logger"); };
+						~MemoryLogger() { events.push_back("-logger"); };
+						void Log(const std::string& message) { messages.push_back(message); };
+						std::vector<std::string> messages{};
+					};
+
+					class Repository {
+					public:
+						using Dependencies = Inject<LoggerTag>;
+						explicit Repository(MemoryLogger& logger_p) : logger_{ logger_p } { events.push_back("+repository"); };
+						~Repository() { events.push_back("-repository"); };
+						void Save(const int order) {
+							orders_.push_back(order);
+							logger_.Log("saved " + std::to_string(order));
+						};
+						size_t size() const { return orders_.size(); };
+
+					private:
+						MemoryLogger& logger_;
+						std::vector<int> orders_{};
+					};
+
+					class OrderService {
+					public:
+						using Dependencies = Inject<Repository, LoggerTag>;
+						OrderService(Repository& repository_p, MemoryLogger& logger_p) : repository_{ repository_p }, logger_{ logger_p } {
+							events.push_back("+service");
+						};
+						~OrderService() { events.push_back("-service"); };
+						void Place(const int order) {
+							logger_.Log("place " + std::to_string(order));
+							repository_.Save(order);
+						};
+
+					private:
+						Repository& repository_;
+						MemoryLogger& logger_;
+					};
+
+					/** Not owned by injector. */
+					class RequestHandler {
+					public:
+						using Dependencies = Inject<OrderService>;
+						explicit RequestHandler(OrderService& service_p) : service_{ service_p } {};
+						void Handle(const int order) { service_.Place(order); };
+
+					private:
+						OrderService& service_;
+					};
+				}
+
+				TEST(DependencyInjectionTest, StaticInjector) {
+					using namespace static_wiring;
+					static_assert(!std::is_polymorphic_v<OrderService>);
+					{
+						// Bindings are in any order: graph is sorted during compilation
+						using AppInjector = Injector<Bind<OrderService>, Bind<Repository>, Bind<LoggerTag, MemoryLogger>>;
+						static_assert(std::is_same_v<AppInjector::Resolve<LoggerTag>, MemoryLogger>);
+						static_assert(AppInjector::construction_order() == std::array<size_t, 3>{ 2, 1, 0 });
+
+						AppInjector injector{};
+						RequestHandler handler{ injector.Create<RequestHandler>() };
+						handler.Handle(7);
+						EXPECT_EQ(injector.Get<Repository>().size(), 1);
+						EXPECT_EQ(injector.Get<LoggerTag>().messages, (std::vector<std::string>{ "place 7", "saved 7" })) << "Logger is shared";
+						EXPECT_EQ(&injector.Get<MemoryLogger>(), &injector.Get<LoggerTag>());
+					}
+					EXPECT_EQ(events, (std::vector<std::string>{ "+logger", "+repository", "+service", "-service", "-repository", "-logger" }));
+				};
+
+				namespace runtime_wiring {
+					using namespace ::pattern::creational::dependency_injection_runtime;
+
+					class ILogger {
+					public:
+						virtual ~ILogger() = default;
+						virtual void Log(const std::string& message) = 0;
+					};
+
+					class MemoryLogger final : public ILogger {
+					public:
+						void Log(const std::string& message) override { messages.push_back(message); };
+						std::vector<std::string> messages{};
+					};
+
+					/** One per thread: no synchronization. */
+					class RequestCounter {
+					public:
+						int count{};
+					};
+
+					class RequestContext {
+					public:
+						using Dependencies = Inject<ILogger, RequestCounter>;
+						RequestContext(ILogger& logger_p, RequestCounter& counter_p) : logger{ logger_p } { id = ++counter_p.count; };
+						~RequestContext() { logger.Log("end " + std::to_string(id)); };
+						ILogger& logger;
+						int id{};
+					};
+
+					class Handler {
+					public:
+						using Dependencies = Inject<RequestContext>;
+						explicit Handler(RequestContext& context_p) : context{ context_p } {};
+						RequestContext& context;
+					};
+
+					class CaptiveSingleton {
+					public:
+						using Dependencies = Inject<RequestContext>;
+						explicit CaptiveSingleton(RequestContext&) {};
+					};
+
+					/** Thread local instance, that uses singleton in destructor. */
+					class ThreadSession {
+					public:
+						using Dependencies = Inject<ILogger>;
+						explicit ThreadSession(ILogger& logger_p) : logger{ logger_p } {};
+						~ThreadSession() { logger.Log("-session"); ++destroyed; };
+						ILogger& logger;
+						inline static int destroyed{};
+					};
+
+					class FlakySingleton {};
+
+					class CycleB;
+
+					class CycleA {
+					public:
+						using Dependencies = Inject<CycleB>;
+						explicit CycleA(CycleB&) {};
+					};
+
+					class CycleB {
+					public:
+						using Dependencies = Inject<CycleA>;
+						explicit CycleB(CycleA&) {};
+					};
+				}
+
+				TEST(DependencyInjectionTest, RuntimeContainer) {
+					using namespace runtime_wiring;
+					Container container{};
+					container.Register<ILogger, MemoryLogger>(Lifetime::kSingleton);
+					container.Register<RequestCounter>(Lifetime::kThreadLocal);
+					container.Register<RequestContext>(Lifetime::kScoped);
+					container.Register<Handler>(Lifetime::kTransient);
+					EXPECT_THROW(container.Resolve<ILogger>(), std::logic_error) << "Resolve before Freeze";
+					container.Freeze();
+					EXPECT_THROW(container.Register<Handler>(Lifetime::kSingleton), std::logic_error);
+
+					ILogger& logger{ container.Resolve<ILogger>() };
+					{
+						Scope scope{ container };
+						Handler& first{ scope.Resolve<Handler>() };
+						Handler& second{ scope.Resolve<Handler>() };
+						EXPECT_NE(&first, &second) << "Transient is new per Resolve";
+						EXPECT_EQ(&first.context, &second.context) << "Scoped is one per scope";
+						EXPECT_EQ(&first.context.logger, &logger) << "Singleton is one per container";
+						EXPECT_EQ(first.context.id, 1);
+						EXPECT_THROW(container.Resolve<RequestContext>(), std::logic_error);
+					}
+					{
+						Scope scope{ container };
+						EXPECT_EQ(scope.Resolve<RequestContext>().id, 2) << "Thread local counter is shared by scopes of thread";
+					}
+					EXPECT_EQ(static_cast<MemoryLogger&>(logger).messages, (std::vector<std::string>{ "end 1", "end 2" }));
+
+					std::thread other{ [&container]() {
+						Scope scope{ container };
+						EXPECT_EQ(scope.Resolve<RequestContext>().id, 1) << "Other thread has own thread local counter";
+						EXPECT_NE(&container.Resolve<RequestCounter>(), nullptr);
+					} };
+					other.join();
+
+					Container captive{};
+					captive.Register<ILogger, MemoryLogger>(Lifetime::kSingleton);
+					captive.Register<RequestCounter>(Lifetime::kThreadLocal);
+					captive.Register<RequestContext>(Lifetime::kScoped);
+					captive.Register<CaptiveSingleton>(Lifetime::kSingleton);
+					EXPECT_THROW(captive.Freeze(), std::logic_error) << "Singleton can't hold scoped instance";
+
+					int attempts{};
+					Container flaky{};
+					flaky.Register<FlakySingleton, FlakySingleton>(Lifetime::kSingleton, [&attempts](Scope&) {
+						if (++attempts == 1) { throw std::runtime_error("factory failed"); }
+						return FlakySingleton{};
+					});
+					EXPECT_THROW(flaky.Freeze(), std::runtime_error);
+					EXPECT_NO_THROW(flaky.Freeze()) << "Failed construction is not reported as cycle";
+					EXPECT_TRUE(flaky.is_frozen());
+
+					Container cyclic{};
+					cyclic.Register<CycleA>(Lifetime::kScoped);
+					cyclic.Register<CycleB>(Lifetime::kTransient);
+					EXPECT_THROW(cyclic.Freeze(), std::logic_error) << "Cycle of not singletons is found by Freeze";
+					EXPECT_FALSE(cyclic.is_frozen());
+
+					// Thread local instances are destroyed at exit of thread, while container is alive
+					Container sessions{};
+					sessions.Register<ILogger, MemoryLogger>(Lifetime::kSingleton);
+					sessions.Register<ThreadSession>(Lifetime::kThreadLocal);
+					sessions.Register<RequestCounter>(Lifetime::kThreadLocal);
+					sessions.Freeze();
+					for (int thread{}; thread < 2; ++thread) {
+						const int destroyed_before{ ThreadSession::destroyed };
+						std::thread pooled{ [&sessions]() {
+							sessions.Resolve<ThreadSession>();
+							EXPECT_EQ(++sessions.Resolve<RequestCounter>().count, 1) << "New thread doesn't get instances of exited thread";
+						} };
+						pooled.join();
+						EXPECT_EQ(ThreadSession::destroyed - destroyed_before, 1);
+					}
+					EXPECT_EQ(static_cast<MemoryLogger&>(sessions.Resolve<ILogger>()).messages.size(), 2);
+
+					// Thread local instances are destroyed with container, not at exit of thread
+					auto owned{ std::make_unique<Container>() };
+					owned->Register<ILogger, MemoryLogger>(Lifetime::kSingleton);
+					owned->Register<ThreadSession>(Lifetime::kThreadLocal);
+					owned->Freeze();
+					const int destroyed_before{ ThreadSession::destroyed };
+					std::promise<void> resolved{};
+					std::promise<void> container_destroyed{};
+					std::thread pooled{ [&owned, &resolved, future = container_destroyed.get_future()]() {
+						owned->Resolve<ThreadSession>();
+						resolved.set_value();
+						future.wait();
+					} };
+					resolved.get_future().wait();
+					owned.reset();
+					EXPECT_EQ(ThreadSession::destroyed - destroyed_before, 1);
+					container_destroyed.set_value();
+					pooled.join();
+					EXPECT_EQ(ThreadSession::destroyed - destroyed_before, 1);
+				};
+			}
+			namespace factory_method {
+				using namespace ::pattern::creational::factory_method;
+
+				class ProductD : public IProduct {
+				public:
+					explicit ProductD() { ++alive; };
+					~ProductD() override { --alive; };
+					inline static int alive{};
+					double payload[4]{};
+				};
+
+				TEST(FactoryMethodTest, FactoryTableClass) {
+					static_assert(CreatorTable::kTable.IsRegistered(ProductID::TC));
+					CreatorTable creator{};
+					EXPECT_NE(dynamic_cast<ProductB*>(creator.Create(ProductID::TB).get()), nullptr);
+
+					FactoryTable<IProduct, ProductID, 4> table{};
+					const ProductID kProductD{ 3 };	// new product type
+					table.Register<ProductID::TA, ProductA>().Register<ProductID{ 3 }, ProductD>();
+					EXPECT_FALSE(table.IsRegistered(ProductID::TB));
+					EXPECT_EQ(table.size_of(kProductD), sizeof(ProductD));
+
+					std::pmr::unsynchronized_pool_resource pool{};
+					{
+						auto product{ table.Create(kProductD, &pool) };
+						EXPECT_NE(dynamic_cast<ProductD*>(product.get()), nullptr);
+						EXPECT_EQ(ProductD::alive, 1);
+					}
+					EXPECT_EQ(ProductD::alive, 0) << "Product is destroyed and returned to pool";
+
+					alignas(ProductD) std::byte storage[sizeof(ProductD)];
+					IProduct* in_place{ table.CreateAt(kProductD, storage) };
+					EXPECT_EQ(dynamic_cast<void*>(in_place), static_cast<void*>(storage));
+					in_place->~IProduct();
+
+					std::pmr::monotonic_buffer_resource arena{};
+					{
+						ProductBlock<IProduct> block{ table.CreateN(kProductD, 1000, &arena) };
+						EXPECT_EQ(block.size(), 1000);
+						EXPECT_EQ(ProductD::alive, 1000);
+						EXPECT_EQ(reinterpret_cast<std::byte*>(&block[999]) - reinterpret_cast<std::byte*>(&block[0]), 999 * sizeof(ProductD))
+							<< "Products are contiguous";
+						EXPECT_NE(dynamic_cast<ProductD*>(&block[500]), nullptr);
+					}
+					EXPECT_EQ(ProductD::alive, 0);
+					EXPECT_TRUE(table.CreateN(ProductID{ 7 }, 10).empty()) << "Not registered product";
+				};
+			}
+			namespace lazy_initialization {
+				using namespace ::pattern::creational::lazy_evaluation;
+
+				TEST(LazyTest, LazyClass) {
+					std::atomic<int> constructions{};
+					Lazy table{ [&constructions]() {
+						++constructions;
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+						return std::vector<int>(1000, 7);
+					} };
+					EXPECT_EQ(table.TryGet(), nullptr);
+
+					constexpr int kThreads{ 8 };
+					std::vector<const std::vector<int>*> seen(kThreads);
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < kThreads; ++thread) {
+						threads.emplace_back([&table, &seen, thread]() { seen[thread] = &table.Get(); });
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					EXPECT_EQ(constructions, 1) << "Concurrent Get must construct once";
+					EXPECT_EQ(std::count(seen.begin(), seen.end(), table.TryGet()), kThreads) << "Get returns reference to one value";
+					EXPECT_EQ(table->size(), 1000);
+
+					int attempts{};
+					Lazy<int> flaky{ [&attempts]() -> int {
+						if (++attempts == 1) { throw std::runtime_error("first attempt fails"); }
+						return 42;
+					} };
+					EXPECT_THROW(flaky.Get(), std::runtime_error);
+					EXPECT_FALSE(flaky.is_ready());
+					EXPECT_EQ(*flaky, 42) << "Failed construction is retried";
+				};
+
+				/** Executor for Prefetch: thread per task. */
+				class ThreadExecutor final {
+				public:
+					~ThreadExecutor() {
+						for (std::thread& thread : threads_) { thread.join(); }
+					};
+
+					template<typename TaskT>
+					void Submit(TaskT&& task_p) { threads_.emplace_back(std::forward<TaskT>(task_p)); };
+
+				private:
+					std::vector<std::thread> threads_{};
+				};
+
+				TEST(LazyTest, LazyPrefetch) {
+					const std::thread::id caller{ std::this_thread::get_id() };
+					std::atomic<bool> is_constructed_in_background{};
+					Lazy table{ [&]() {
+						std::this_thread::sleep_for(std::chrono::milliseconds(30));
+						is_constructed_in_background = std::this_thread::get_id() != caller;
+						return std::vector<int>(1000, 1);
+					} };
+					Lazy<int> unused{ []() -> int { throw std::logic_error("must not be constructed"); } };
+					{
+						ThreadExecutor executor{};
+						EXPECT_TRUE(table.Prefetch(executor));
+						EXPECT_FALSE(table.Prefetch(executor)) << "Construction is already started";
+						EXPECT_EQ(table.Get().size(), 1000) << "Get joins construction in flight";
+						EXPECT_TRUE(is_constructed_in_background);
+						EXPECT_FALSE(table.Prefetch(executor));
+
+						Lazy<int> failing{ []() -> int { throw std::runtime_error("background failure"); } };
+						failing.Prefetch(executor);
+						EXPECT_THROW(failing.Get(), std::runtime_error);
+
+						for (int i{}; i < 100; ++i) {	// destructor waits for the end of task
+							Lazy<std::vector<int>> destroyed_early{ []() { return std::vector<int>(100, 1); } };
+							destroyed_early.Prefetch(executor);
+						}
+						for (int i{}; i < 100; ++i) {	// failed task may still run, when the next Prefetch starts
+							Lazy<int> retried{ []() -> int { throw std::runtime_error("background failure"); } };
+							for (int attempt{}; attempt < 4; ++attempt) { retried.Prefetch(executor); }
+						}
+					}
+					EXPECT_FALSE(unused.is_ready());
+				};
+
+				class Fibonacci {
+				public:
+					long long operator()(const int n) { return memoized_(n); };
+
+				private:
+					Memoize<std::function<long long(int)>, int> memoized_{
+						[this](const int n) -> long long { return n <= 1 ? n : memoized_(n - 1) + memoized_(n - 2); }, 256 };
+				};
+
+				TEST(LazyTest, MemoizeClass) {
+					Fibonacci fibonacci{};
+					EXPECT_EQ(fibonacci(90), 2880067194370816120LL);
+
+					std::atomic<int> calls{};
+					auto slow_square = [&calls](const int x) {
+						++calls;
+						if (x == 12) { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+						return x * x;
+					};
+					Memoize<decltype(slow_square), int, std::hash<int>, 4> square{ slow_square, 8 };
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < 8; ++thread) {
+						threads.emplace_back([&square]() { EXPECT_EQ(square(12), 144); });
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					EXPECT_EQ(calls, 1) << "Concurrent misses of one key compute once";
+					MemoizeStats stats{ square.stats() };
+					EXPECT_EQ(stats.misses, 1);
+					EXPECT_EQ(stats.hits + stats.shared, 7);
+
+					for (int x{}; x < 100; ++x) { square(x); }
+					stats = square.stats();
+					EXPECT_LE(stats.size, 8) << "Cache is bounded";
+					EXPECT_GT(stats.evictions, 0);
+
+					Memoize<decltype(slow_square), int, std::hash<int>, 1> large{ slow_square, 1000 };
+					for (int x{ 100 }; x < 3100; ++x) { large(x); }	// cache is rehashed many times
+					stats = large.stats();
+					EXPECT_EQ(stats.size, 1000);
+					EXPECT_EQ(stats.evictions, 2000);
+					EXPECT_EQ(large(3099), 3099 * 3099);
+					EXPECT_EQ(large.stats().hits, 1);
+					large.Clear();
+					EXPECT_EQ(large.stats().size, 0);
+
+					Memoize<std::function<int(int)>, int> failing{ [](int) -> int { throw std::runtime_error("no value"); } };
+					EXPECT_THROW(failing(1), std::runtime_error);
+					EXPECT_THROW(failing(1), std::runtime_error) << "Exception is not cached";
+					EXPECT_EQ(failing.stats().misses, 2);
+				};
+			}
 
 			namespace object_pool {
 				using namespace ::pattern::creational::object_pool;
@@ -657,6 +1655,46 @@ namespace {
 					client.creator_ = std::make_unique<PrototypeA>();
 					client.creator_->Clone();
 				};
+
+				struct Monster {
+					int health{};
+					float speed{};
+					float position[3]{};
+				};
+
+				struct Npc {
+					std::string name{};
+					int level{};
+				};
+
+				TEST(PrototypeTest, PrototypeRegistryClass) {
+					static_assert(std::is_trivially_copyable_v<Monster>);
+					PrototypeRegistry<std::string, Monster> monsters{};
+					monsters.Register("orc", Monster{ 100, 1.5f, { 1, 2, 3 } });
+					monsters.Register("goblin", Monster{ 30, 3.0f });
+
+					std::vector<Monster> frame(10'001);
+					EXPECT_TRUE(monsters.CloneInto("orc", frame));
+					EXPECT_TRUE(std::all_of(frame.begin(), frame.end(), [](const Monster& monster) {
+						return monster.health == 100 && monster.speed == 1.5f && monster.position[2] == 3.0f; }));
+					EXPECT_TRUE(monsters.CloneInto("goblin", std::span{ frame }.subspan(3, 7)));
+					EXPECT_EQ(frame[2].health, 100);
+					EXPECT_EQ(frame[3].health, 30);
+					EXPECT_EQ(frame[9].health, 30);
+					EXPECT_EQ(frame[10].health, 100);
+					EXPECT_FALSE(monsters.CloneInto("dragon", frame));
+
+					alignas(Monster) std::byte storage[sizeof(Monster) * 5];
+					const Monster* raw{ UninitializedCloneInto(*monsters.Find("goblin"), storage, 5) };
+					EXPECT_EQ(raw[4].speed, 3.0f);
+
+					PrototypeRegistry<int, Npc> npcs{};
+					npcs.Register(1, Npc{ "guard", 5 });
+					const std::vector<Npc> guards{ npcs.CloneN(1, 100) };
+					EXPECT_EQ(guards.size(), 100);
+					EXPECT_EQ(guards[99].name, "guard");
+					EXPECT_TRUE(npcs.CloneN(2, 100).empty());
+				};
 			}
 			namespace singleton {
                 using namespace ::pattern::creational::singleton;
@@ -676,6 +1714,209 @@ namespace {
 
 					//pattern::creational::singleton_example::Singleton_2& a{ pattern::creational::singleton_example::Singleton_2::Get() };
                 };
+
+				class Counters final : public SingletonConcurrent<Counters> {
+				public:
+					Counters() { ++constructions; };
+					~Counters() override = default;
+
+					inline static std::atomic<int> constructions{};
+					std::atomic<long long> events{};
+				};
+
+				TEST(SingletonTest, SingletonConcurrentClass) {
+					constexpr int kThreads{ 8 };
+					const int constructions{ Counters::constructions };
+					std::vector<std::thread> threads{};
+					std::vector<Counters*> seen(kThreads);
+					for (int thread{}; thread < kThreads; ++thread) {
+						threads.emplace_back([&seen, thread]() {
+							seen[thread] = &Counters::GetSingleton();
+							for (int i{}; i < 10'000; ++i) { Counters::GetSingleton().events.fetch_add(1, std::memory_order_relaxed); }
+						});
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					EXPECT_EQ(Counters::constructions, constructions + 1) << "Concurrent first use must construct once";
+					EXPECT_EQ(std::count(seen.begin(), seen.end(), seen[0]), kThreads);
+					EXPECT_EQ(Counters::GetSingleton().events, kThreads * 10'000);
+
+					std::atomic<bool> is_pinned{};
+					std::atomic<bool> is_released{};
+					std::thread reader{ [&]() {
+						const Counters::Pin pin{ Counters::PinSingleton() };
+						is_pinned = true;
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+						pin->events = -1;	// instance is alive while pinned
+						is_released = true;
+					} };
+					while (!is_pinned) { std::this_thread::yield(); }
+					Counters::DestructSingleton();
+					EXPECT_TRUE(is_released) << "DestructSingleton must wait for pins";
+					reader.join();
+					EXPECT_FALSE(Counters::IsConstructed());
+					EXPECT_EQ(Counters::GetSingleton().events, 0);
+					EXPECT_EQ(Counters::constructions, constructions + 2);
+					Counters::DestructSingleton();
+				};
+
+				/** Own singleton, so benchmark doesn't depend on order of tests. */
+				class BenchmarkCounters final : public SingletonConcurrent<BenchmarkCounters> {
+				public:
+					~BenchmarkCounters() override = default;
+				};
+
+				TEST(SingletonTest, SingletonConcurrentBenchmark) {
+					constexpr int kIterations{ 10'000'000 };
+					BenchmarkCounters::GetSingleton();
+					BenchmarkCounters* volatile plain_pointer{ &BenchmarkCounters::GetSingleton() };	// volatile: load in every iteration
+
+					long long checksum{};
+					auto start{ std::chrono::steady_clock::now() };
+					for (int i{}; i < kIterations; ++i) {
+						checksum += reinterpret_cast<std::uintptr_t>(&BenchmarkCounters::GetSingleton()) & 1;
+						std::atomic_signal_fence(std::memory_order_seq_cst);	// keeps load in loop
+					}
+					const std::chrono::duration<double, std::nano> concurrent_time{ std::chrono::steady_clock::now() - start };
+
+					start = std::chrono::steady_clock::now();
+					for (int i{}; i < kIterations; ++i) {
+						checksum += reinterpret_cast<std::uintptr_t>(plain_pointer) & 1;
+						std::atomic_signal_fence(std::memory_order_seq_cst);
+					}
+					const std::chrono::duration<double, std::nano> load_time{ std::chrono::steady_clock::now() - start };
+					std::cout << "SingletonConcurrent::GetSingleton: " << concurrent_time.count() / kIterations << " ns/call\n";
+					std::cout << "Load of pointer: " << load_time.count() / kIterations << " ns/call\n";
+
+					EXPECT_EQ(checksum, 0);
+					BenchmarkCounters::DestructSingleton();
+				};
+
+				class ShardedStatistics final : public SingletonSharded<ShardedStatistics> {
+				public:
+					std::atomic<long long> requests{};
+					std::atomic<long long> bytes{};
+				};
+
+				TEST(SingletonTest, SingletonShardedClass) {
+					const size_t shards_count{ ShardedStatistics::shards_count() };
+					EXPECT_GE(shards_count, 1);
+					EXPECT_EQ(shards_count & (shards_count - 1), 0);
+					if (shards_count > 1) {
+						EXPECT_GE(reinterpret_cast<std::uintptr_t>(&ShardedStatistics::GetShard(1))
+								  - reinterpret_cast<std::uintptr_t>(&ShardedStatistics::GetShard(0)), 64) << "Shards must be on different cache lines";
+					}
+					EXPECT_EQ(&ShardedStatistics::GetShard(shards_count), &ShardedStatistics::GetShard(0)) << "Index is wrapped";
+					EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&ShardedStatistics::GetShard(0)) % 64, 0);
+
+					constexpr int kThreads{ 8 };
+					constexpr int kRequests{ 100'000 };
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < kThreads; ++thread) {
+						threads.emplace_back([]() {
+							ShardedStatistics& shard{ ShardedStatistics::GetShard() };
+							EXPECT_EQ(&ShardedStatistics::GetShard(), &shard) << "Thread keeps its shard";
+							for (int i{}; i < kRequests; ++i) {
+								shard.requests.fetch_add(1, std::memory_order_relaxed);
+								shard.bytes.fetch_add(10, std::memory_order_relaxed);
+							}
+						});
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+
+					const long long requests{ ShardedStatistics::Reduce(0LL, [](long long sum, const ShardedStatistics& shard) {
+						return sum + shard.requests.load(std::memory_order_relaxed); }) };
+					EXPECT_EQ(requests, kThreads * kRequests);
+					long long bytes{};
+					ShardedStatistics::ForEachShard([&bytes](ShardedStatistics& shard) { bytes += shard.bytes.exchange(0); });
+					EXPECT_EQ(bytes, kThreads * kRequests * 10LL);
+				};
+
+				namespace registry {
+					std::mutex log_mutex{};
+					std::vector<std::string> log{};
+					std::condition_variable arrived_condition{};
+					int parallel_count{};	// constructors, that must run at once. 0 - no check
+					int arrived_count{};
+					bool is_sequential{};
+
+					void Log(std::string message) {
+						std::lock_guard lock{ log_mutex };
+						log.push_back(std::move(message));
+					};
+
+					/** Wait until parallel_count constructors run at once. Sequential construction can't reach it. */
+					void WaitForParallel() {
+						std::unique_lock lock{ log_mutex };
+						if (parallel_count == 0) { return; }
+						++arrived_count;
+						arrived_condition.notify_all();
+						if (!arrived_condition.wait_for(lock, std::chrono::seconds(5), []() { return arrived_count >= parallel_count; })) {
+							is_sequential = true;
+						}
+					};
+
+					/** Singleton with heavy constructor. */
+					template<int kId>
+					class Table {
+					public:
+						Table() {
+							WaitForParallel();
+							Log("+" + std::to_string(kId));
+						};
+						~Table() { Log("-" + std::to_string(kId)); };
+						int id{ kId };
+					};
+
+					class Service {
+					public:
+						Service(Table<1>& table_1, Table<2>& table_2, Table<3>& table_3) : sum{ table_1.id + table_2.id + table_3.id } { Log("+service"); };
+						~Service() { Log("-service"); };
+						int sum;
+					};
+
+					class Broken {
+					public:
+						Broken() { throw std::runtime_error("Broken"); };
+					};
+				}
+
+				TEST(SingletonTest, SingletonRegistryClass) {
+					using namespace registry;
+					{
+						SingletonRegistry singletons{};
+						singletons.Register<Service, Table<1>, Table<2>, Table<3>>([](SingletonRegistry& registry) {
+							return std::make_unique<Service>(registry.Get<Table<1>>(), registry.Get<Table<2>>(), registry.Get<Table<3>>());
+						});
+						singletons.Register<Table<1>>();
+						singletons.Register<Table<2>>();
+						singletons.Register<Table<3>>();
+						EXPECT_THROW(singletons.Get<Service>(), std::logic_error);
+
+						parallel_count = 3;
+						singletons.Initialize(4);
+						parallel_count = 0;
+						EXPECT_FALSE(is_sequential) << "Independent singletons must be constructed in parallel";
+						EXPECT_EQ(arrived_count, 3);
+						EXPECT_EQ(singletons.Get<Service>().sum, 6);
+						EXPECT_EQ(log.back(), "+service") << "Dependent is constructed after dependencies";
+						log.clear();
+					}
+					EXPECT_EQ(log, (std::vector<std::string>{ "-service", "-3", "-2", "-1" })) << "Shutdown in reverse topological order";
+					log.clear();
+
+					SingletonRegistry cyclic{};
+					cyclic.Register<Table<1>, Table<2>>();
+					cyclic.Register<Table<2>, Table<1>>();
+					EXPECT_THROW(cyclic.Initialize(), std::logic_error);
+
+					SingletonRegistry broken{};
+					broken.Register<Table<1>>();
+					broken.Register<Broken, Table<1>>();
+					EXPECT_THROW(broken.Initialize(2), std::runtime_error);
+					EXPECT_FALSE(broken.is_initialized());
+					EXPECT_EQ(log, (std::vector<std::string>{ "+1", "-1" })) << "Constructed singletons are destroyed on failure";
+					log.clear();
+				};
 			}
 		} // !namespace creational
 
@@ -686,7 +1927,101 @@ namespace {
 
 
 		namespace distributed {
+			namespace write_ahead_log {
+				using namespace ::pattern::distributed_system::write_ahead_log;
+
+				TEST(WriteAheadLogTest, JournalInvokerReplay) {
+					const std::filesystem::path directory{ std::filesystem::temp_directory_path() / "design-patterns-wal-test" };
+					std::filesystem::remove_all(directory);
+					const LogOptions options{ .segment_size = 4096, .sync_batch_records = 16 };
+
+					Account account{};
+					{
+						JournalInvoker invoker{ directory, options };
+						for (int i{ 1 }; i <= 1000; ++i) {
+							CommandDeposit deposit{ account, i };
+							const LSN lsn{ invoker.InvokeCommand(deposit) };
+							if (i % 100 == 0) {
+								invoker.Commit(lsn);
+								EXPECT_GE(invoker.log().durable_lsn(), lsn);
+							}
+						}
+						EXPECT_GT(invoker.log().SegmentIndices().size(), 1) << "Log must be split in segments";
+					} // crash or restart
+
+					Account restored_account{};
+					JournalInvoker invoker{ directory, options };
+					invoker.RegisterCommand(CommandDeposit::kTypeID, [&restored_account](std::span<const std::byte> bytes) {
+						return CommandDeposit::Deserialize(restored_account, bytes);
+					});
+					EXPECT_EQ(invoker.Replay(), 1000);
+					EXPECT_EQ(restored_account.balance, account.balance);
+
+					// Log continues after restart
+					CommandDeposit deposit{ restored_account, 5 };
+					invoker.InvokeCommand(deposit);
+					Account replayed_again{};
+					invoker.RegisterCommand(CommandDeposit::kTypeID, [&replayed_again](std::span<const std::byte> bytes) {
+						return CommandDeposit::Deserialize(replayed_again, bytes);
+					});
+					EXPECT_EQ(invoker.Replay(), 1001);
+					EXPECT_EQ(replayed_again.balance, restored_account.balance);
+
+					std::filesystem::remove_all(directory);
+				}
 
+				/** Command, that fails on execution. */
+				class CommandWithdraw : public IJournaledCommand {
+				public:
+					static constexpr std::uint32_t kTypeID{ 2 };
+
+					CommandWithdraw(Account& account_p, const std::int64_t amount_p) noexcept
+						: account_{ account_p }, amount_{ amount_p } {
+					};
+
+					void Execute() override {
+						if (account_.balance < amount_) { throw std::runtime_error("Insufficient balance"); }
+						account_.balance -= amount_;
+					};
+					inline std::uint32_t TypeID() const noexcept override { return kTypeID; };
+					inline void Serialize(std::vector<std::byte>& buffer_p) const override { WriteValue(buffer_p, amount_); };
+
+				private:
+					Account& account_;
+					std::int64_t amount_;
+				};
+
+				TEST(WriteAheadLogTest, JournalInvokerThrowingCommand) {
+					const std::filesystem::path directory{ std::filesystem::temp_directory_path() / "design-patterns-wal-throw-test" };
+					std::filesystem::remove_all(directory);
+
+					Account account{};
+					{
+						JournalInvoker invoker{ directory };
+						CommandDeposit deposit{ account, 10 };
+						invoker.InvokeCommand(deposit);
+						CommandWithdraw withdraw{ account, 100 };
+						EXPECT_THROW(invoker.InvokeCommand(withdraw), std::runtime_error);
+						EXPECT_EQ(account.balance, 10);
+						CommandWithdraw withdraw_valid{ account, 4 };
+						invoker.InvokeCommand(withdraw_valid);
+					}
+
+					Account restored_account{};
+					JournalInvoker invoker{ directory };
+					invoker.RegisterCommand(CommandDeposit::kTypeID, [&restored_account](std::span<const std::byte> bytes) {
+						return CommandDeposit::Deserialize(restored_account, bytes);
+					});
+					invoker.RegisterCommand(CommandWithdraw::kTypeID, [&restored_account](std::span<const std::byte> bytes) {
+						size_t offset{};
+						return std::make_unique<CommandWithdraw>(restored_account, ReadValue<std::int64_t>(bytes, offset));
+					});
+					EXPECT_EQ(invoker.Replay(), 2) << "Failed command must not be written";
+					EXPECT_EQ(restored_account.balance, 6);
+
+					std::filesystem::remove_all(directory);
+				}
+			} // !namespace write_ahead_log
 		} // !namespace distributed
 
 
@@ -739,6 +2074,243 @@ namespace {
 					}
 					int a = 1 + 66;
 				};
+
+				TEST(FlyweightTest, FlyweightFabricConcurrent) {
+					constexpr int kThreads{ 8 };
+					constexpr int kKeys{ 64 };
+					FlyweightFabric<int, FlyweightShared, int> flyweight_fabric{};
+					std::vector<std::shared_ptr<FlyweightShared>> held{};	// flyweights, that are alive during the test
+					for (int key{}; key < kKeys; key += 2) { held.push_back(flyweight_fabric.GetFlyweight(key)); }
+
+					std::atomic<int> mismatches{};
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < kThreads; ++thread) {
+						threads.emplace_back([&, thread]() {
+							for (int i{}; i < 20'000; ++i) {
+								const int key{ (i * 7 + thread) % kKeys };
+								const std::shared_ptr<FlyweightShared> flyweight{ flyweight_fabric.GetFlyweight(key) };
+								if (key % 2 == 0 && flyweight != held[key / 2]) { ++mismatches; }
+							}
+						});
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					EXPECT_EQ(mismatches, 0) << "Alive flyweight must be shared";
+					EXPECT_EQ(flyweight_fabric.size(), kKeys / 2) << "Released flyweights must be evicted by their keys";
+
+					std::shared_ptr<FlyweightShared> outlives_fabric{};
+					{
+						FlyweightFabric<int, FlyweightShared, int> local_fabric{};
+						outlives_fabric = local_fabric.GetFlyweight(1);
+					}
+					outlives_fabric.reset();	// deleter must not touch destroyed fabric
+					held.clear();
+					EXPECT_EQ(flyweight_fabric.size(), 0);
+				};
+
+				/** Flyweight, whose construction from negative key fails. */
+				class FailingFlyweight final : public IFlyweight<int> {
+				public:
+					explicit FailingFlyweight(const int key_p) {
+						if (key_p < 0) { throw std::invalid_argument("Negative key"); }
+					};
+					void operation(int) override {};
+				};
+
+				TEST(FlyweightTest, FlyweightFabricFailedCreate) {
+					FlyweightFabric<int, FailingFlyweight, int, 1> fabric{};
+					const std::shared_ptr<FailingFlyweight> alive{ fabric.GetFlyweight(1) };
+					EXPECT_THROW(fabric.GetFlyweight(-1), std::invalid_argument);
+					EXPECT_EQ(fabric.size(), 1) << "Failed key must not leave entry";
+					EXPECT_THROW(fabric.GetFlyweight(-1), std::invalid_argument) << "Shard must stay unlocked";
+					EXPECT_EQ(fabric.GetFlyweight(1), alive);
+
+					FlyweightFabric<int, FailingFlyweight, int, 1> retaining{ RetentionOptions{ .max_count = 4 } };
+					const FailingFlyweight* retained{ retaining.GetFlyweight(2).get() };
+					EXPECT_THROW(retaining.GetFlyweight(-2), std::invalid_argument);
+					EXPECT_EQ(retaining.GetFlyweight(2).get(), retained);
+					EXPECT_EQ(retaining.size(), 1);
+				};
+
+				/** Key, whose copy throws on demand. */
+				struct ThrowingKey {
+					static inline int copies_until_throw{ -1 };
+
+					explicit ThrowingKey(const int value_p) noexcept : value{ value_p } {};
+					ThrowingKey(const ThrowingKey& other) : value{ other.value } {
+						if (copies_until_throw >= 0 && copies_until_throw-- == 0) { throw std::runtime_error("Key copy failed"); }
+					};
+					bool operator==(const ThrowingKey&) const = default;
+
+					int value;
+				};
+
+				struct ThrowingKeyHash {
+					inline size_t operator()(const ThrowingKey& key_p) const noexcept { return std::hash<int>{}(key_p.value); };
+				};
+
+				TEST(FlyweightTest, FlatHashMapClass) {
+					FlatHashMap<int, int> map{};
+					for (int i{}; i < 10'000; ++i) { EXPECT_TRUE(map.try_emplace(i, i * 2).second); }
+					EXPECT_FALSE(map.try_emplace(5, 0).second);
+					EXPECT_EQ(map.find(5)->second, 10);
+					for (int i{}; i < 10'000; i += 2) { EXPECT_EQ(map.erase(i), 1); }
+					EXPECT_EQ(map.size(), 5'000);
+					EXPECT_EQ(map.find(4), map.end());
+					EXPECT_TRUE(map.contains(9'999));
+					size_t count{};
+					for (const auto& [key, value] : map) { count += (value == key * 2) ? 1 : 0; }
+					EXPECT_EQ(count, 5'000);
+
+					FlatHashMap<std::string, int, TransparentStringHash> strings{};
+					strings.try_emplace(std::string_view{ "a long string key, that is not in small string buffer" }, 1);
+					EXPECT_EQ(strings.find(std::string_view{ "a long string key, that is not in small string buffer" })->second, 1);
+					EXPECT_EQ(strings.find("absent"), strings.end());
+
+					// Rehash with throwing key copy leaves elements unchanged
+					FlatHashMap<ThrowingKey, std::string, ThrowingKeyHash> throwing{};
+					const size_t full_size{ 16 / 8 * 7 };
+					for (int i{}; i < static_cast<int>(full_size); ++i) {
+						throwing.try_emplace(ThrowingKey{ i }, "a long value, that is not in small string buffer");
+					}
+					ThrowingKey::copies_until_throw = 5;
+					EXPECT_THROW(throwing.try_emplace(ThrowingKey{ -1 }, "new"), std::runtime_error);
+					ThrowingKey::copies_until_throw = -1;
+					EXPECT_EQ(throwing.size(), full_size);
+					for (int i{}; i < static_cast<int>(full_size); ++i) {
+						EXPECT_EQ(throwing.find(ThrowingKey{ i })->second, "a long value, that is not in small string buffer");
+					}
+				};
+
+				/** Flyweight with intrinsic state from key. */
+				class Glyph final : public IFlyweight<int> {
+				public:
+					explicit Glyph(const std::string& name_p) : name_{ name_p } {};
+					void operation(int) override {};
+					inline const std::string& name() const noexcept { return name_; };
+				private:
+					std::string name_;
+				};
+
+				TEST(FlyweightTest, FlyweightFabricHeterogeneousLookup) {
+					FlyweightFabric<std::string, Glyph, int, 16, TransparentStringHash, FlatCacheMap> fabric{};
+					const std::string name{ "Latin Capital Letter A with Grave, Times New Roman, 12pt" };
+					const std::shared_ptr<Glyph> glyph{ fabric.GetFlyweight(std::string_view{ name }) };
+					EXPECT_EQ(glyph->name(), name);
+					EXPECT_EQ(fabric.GetFlyweight(name), glyph);
+					EXPECT_EQ(fabric.GetFlyweight(std::string_view{ name }), glyph);
+					EXPECT_EQ(fabric.size(), 1);
+
+					FlyweightFabric<std::string, Glyph, int, 4, TransparentStringHash> unordered_fabric{};
+					const std::shared_ptr<Glyph> unordered_glyph{ unordered_fabric.GetFlyweight(std::string_view{ name }) };
+					EXPECT_EQ(unordered_fabric.GetFlyweight(std::string_view{ name }), unordered_glyph);
+				};
+
+				TEST(FlyweightTest, FlyweightFabricRetention) {
+					FlyweightFabric<int, FlyweightShared, int, 1> flyweight_fabric{ RetentionOptions{ .max_count = 2 } };
+					const FlyweightShared* first{ flyweight_fabric.GetFlyweight(1).get() };	// released right away
+					EXPECT_EQ(flyweight_fabric.GetFlyweight(1).get(), first) << "Released flyweight must be retained";
+					flyweight_fabric.GetFlyweight(2);
+					flyweight_fabric.GetFlyweight(1);	// 1 is the most recently used
+					flyweight_fabric.GetFlyweight(3);	// evicts 2
+					FlyweightStats stats{ flyweight_fabric.stats() };
+					EXPECT_EQ(stats.misses, 3);
+					EXPECT_EQ(stats.hits, 2);
+					EXPECT_EQ(stats.evictions, 1);
+					EXPECT_EQ(stats.retained_count, 2);
+					EXPECT_EQ(stats.retained_bytes, 2 * sizeof(FlyweightShared));
+					EXPECT_EQ(flyweight_fabric.size(), 2);
+
+					EXPECT_EQ(flyweight_fabric.GetFlyweight(1).get(), first);
+					flyweight_fabric.GetFlyweight(2);
+					EXPECT_EQ(flyweight_fabric.stats().misses, 4) << "Evicted flyweight must be created again";
+
+					flyweight_fabric.ReleaseRetained();
+					EXPECT_EQ(flyweight_fabric.size(), 0);
+					EXPECT_EQ(flyweight_fabric.stats().retained_count, 0);
+
+					FlyweightFabric<int, FlyweightShared, int, 4> bytes_fabric{ RetentionOptions{ .max_bytes = 4 * sizeof(FlyweightShared) } };
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < 4; ++thread) {
+						threads.emplace_back([&bytes_fabric, thread]() {
+							for (int i{}; i < 10'000; ++i) { bytes_fabric.GetFlyweight((i * 5 + thread) % 32); }
+						});
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					stats = bytes_fabric.stats();
+					EXPECT_LE(stats.retained_count, 4);
+					EXPECT_EQ(stats.hits + stats.misses, 40'000);
+					EXPECT_EQ(bytes_fabric.size(), stats.retained_count);
+
+					FlyweightFabric<int, FlyweightShared, int> default_fabric{};
+					default_fabric.GetFlyweight(1);
+					EXPECT_EQ(default_fabric.size(), 0) << "Without retention unused flyweight is dropped";
+
+					// Budget is global for all shards. Used flyweights don't take it
+					FlyweightFabric<int, FlyweightShared, int> single_fabric{ RetentionOptions{ .max_count = 1 } };
+					for (int key{}; key < 32; ++key) { single_fabric.GetFlyweight(key); }
+					EXPECT_EQ(single_fabric.stats().retained_count, 1);
+					EXPECT_EQ(single_fabric.size(), 1);
+					single_fabric.ReleaseRetained();
+					const std::shared_ptr<FlyweightShared> used_1{ single_fabric.GetFlyweight(1) };
+					const std::shared_ptr<FlyweightShared> used_2{ single_fabric.GetFlyweight(2) };
+					EXPECT_EQ(single_fabric.stats().retained_count, 0);
+					single_fabric.GetFlyweight(3);
+					EXPECT_EQ(single_fabric.stats().retained_count, 1);
+					EXPECT_EQ(single_fabric.GetFlyweight(2), used_2);
+					EXPECT_EQ(single_fabric.size(), 3);
+
+					// Order of eviction is global: the last released flyweight is retained, whatever its shard
+					FlyweightFabric<int, FlyweightShared, int> lru_fabric{ RetentionOptions{ .max_count = 1 } };
+					static_assert(decltype(lru_fabric)::shards_count() >= 12);
+					for (const int key : { 1, 2, 3 }) {	// keys 1, 2, 3, 9, 10, 11 are in different shards
+						std::shared_ptr<FlyweightShared> first{ lru_fabric.GetFlyweight(key) };
+						std::shared_ptr<FlyweightShared> last{ lru_fabric.GetFlyweight(key + 8) };
+						first.reset();
+						last.reset();	// its shard has no other retained flyweight
+					}
+					EXPECT_EQ(lru_fabric.size(), 1);
+					const size_t misses{ lru_fabric.stats().misses };
+					lru_fabric.GetFlyweight(11);
+					EXPECT_EQ(lru_fabric.stats().misses, misses) << "The last released flyweight must be retained";
+					lru_fabric.GetFlyweight(1);
+					EXPECT_EQ(lru_fabric.stats().misses, misses + 1);
+				};
+
+				TEST(FlyweightTest, StringInternerClass) {
+					StringInterner interner{ 256 };
+					const StringID price{ interner.Intern("price") };
+					EXPECT_EQ(interner.Intern(std::string{ "price" }), price);
+					EXPECT_EQ(interner.View(price), "price");
+					EXPECT_EQ(interner.Find("volume"), std::nullopt);
+					EXPECT_EQ(interner.TryView(100), std::nullopt);
+
+					const std::string long_name(1000, 'x');	// own arena block
+					const std::vector<std::string_view> columns{ "volume", "price", "", long_name, "volume" };
+					const std::vector<StringID> ids{ interner.InternBulk(columns) };
+					EXPECT_EQ(ids, (std::vector<StringID>{ 1, price, 2, 3, 1 })) << "Ids are dense in order of first interning";
+					EXPECT_EQ(interner.View(2), "");
+					EXPECT_EQ(interner.View(3), long_name);
+					EXPECT_EQ(interner.size(), 4);
+
+					constexpr int kThreads{ 4 };
+					constexpr int kStrings{ 5'000 };	// several segments of id table
+					std::atomic<int> mismatches{};
+					std::vector<std::thread> threads{};
+					for (int thread{}; thread < kThreads; ++thread) {
+						threads.emplace_back([&]() {
+							for (int i{}; i < kStrings; ++i) {
+								const std::string symbol{ "symbol_" + std::to_string(i) };
+								const StringID id{ interner.Intern(symbol) };
+								if (interner.View(id) != symbol) { ++mismatches; }
+								if (interner.View(price) != "price") { ++mismatches; }
+							}
+						});
+					}
+					for (std::thread& thread : threads) { thread.join(); }
+					EXPECT_EQ(mismatches, 0);
+					EXPECT_EQ(interner.size(), 4 + kStrings);
+					EXPECT_EQ(interner.Find("symbol_4999").has_value(), true);
+				};
 			}
 			namespace marker {}
 			namespace proxy {}